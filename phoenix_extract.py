@@ -303,6 +303,13 @@ def strdepex(data):
 
 lzint_path = os.path.join(os.path.dirname(__file__), "unlzint")
 
+# LZINT is EFI 1.1 compression, decoded in-process by the library built
+# with `make`. Without it, the unlzint tool is run for every section.
+try:
+  biosdecomp = ctypes.CDLL(os.path.join(os.path.dirname(os.path.realpath(__file__)), "libbiosdecomp.so"))
+except OSError:
+  biosdecomp = None
+
 def unlzint(data):
     import subprocess
     try:
@@ -312,6 +319,12 @@ def unlzint(data):
           return data
       if clen + 8 < len(data):
           data = data[:clen + 8]
+      if biosdecomp:
+          outd = ctypes.create_string_buffer(ulen)
+          if biosdecomp.LZINTDecode(data, len(data), outd, ulen) != 0:
+              print "<decompression error>"
+              return data
+          return outd.raw
       p = subprocess.Popen([lzint_path, "-", "-"], stdout=subprocess.PIPE, stdin=subprocess.PIPE)
       outd, errd = p.communicate(input=data)
       return outd
@@ -32,7 +32,7 @@
 
 #include "bios_extract.h"
 #include "compat.h"
-#include "lh5_extract.h"
+#include "codec.h"
 
 struct AMI95ModuleName {
 	uint8_t Id;
@@ -200,23 +200,27 @@ AMI95Extract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 	printf("AMI95 Version\t: %.4s (%s)\n", abc->Version, Date);
 
 	/* First, the boot rom */
+	struct ModuleInfo Info;
 	uint32_t BootOffset;
-	int fd;
 
 	BootOffset = AMIBOffset & 0xFFFF0000;
 
 	printf("0x%05X (%6d bytes) -> amiboot.rom\n", BootOffset,
 	       BIOSLength - BootOffset);
 
-	fd = open("amiboot.rom", O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (fd < 0) {
-		fprintf(stderr, "Error: unable to open %s: %s\n\n",
-			"amiboot.rom", strerror(errno));
+	Info.Offset = BootOffset;
+	Info.PackedSize = BIOSLength - BootOffset;
+	Info.ExpandedSize = BIOSLength - BootOffset;
+	Info.Id = -1;
+	Info.Type = "ami95";
+	Info.Codec = CodecName(CODEC_STORED);
+	Info.Name = "Boot Block";
+	Info.Guid = NULL;
+	Info.File = "amiboot.rom";
+	if (ModuleWanted(&Info) &&
+	    !WriteOutputFile("amiboot.rom", BIOSImage + BootOffset,
+			     BIOSLength - BootOffset))
 		return FALSE;
-	}
-
-	write(fd, BIOSImage + BootOffset, BIOSLength - BootOffset);
-	close(fd);
 
 	/* now dump the individual modules */
 	if (BIOSLength > 0x100000)
@@ -286,18 +290,24 @@ AMI95Extract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 		else
 			printf("\n");
 
-		Buffer = MMapOutputFile(filename, BufferSize);
-		if (!Buffer)
-			return FALSE;
-
-		if (Compressed)
-			LH5Decode(BIOSImage + (Offset - BIOSOffset) + 0x14,
-				  ROMSize, Buffer, BufferSize);
-		else
-			memcpy(Buffer, BIOSImage + (Offset - BIOSOffset) + 0x0C,
-			       BufferSize);
-
-		munmap(Buffer, BufferSize);
+		Info.Offset = Offset - BIOSOffset + (Compressed ? 0x14 : 0x0C);
+		Info.PackedSize = ROMSize;
+		Info.ExpandedSize = BufferSize;
+		Info.Id = part->PartID;
+		Info.Codec = CodecName(Compressed ? CODEC_LH5 : CODEC_STORED);
+		Info.Name = ModuleName;
+		Info.File = filename;
+		if (ModuleWanted(&Info)) {
+			Buffer = MMapOutputFile(filename, BufferSize);
+			if (!Buffer)
+				return FALSE;
+
+			CodecDecode(Compressed ? CODEC_LH5 : CODEC_STORED,
+				    BIOSImage + Info.Offset, ROMSize, Buffer,
+				    BufferSize, CODEC_PARAMETER_DEFAULT);
+
+			CloseOutputFile(Buffer, BufferSize);
+		}
 
 		if ((le16toh(part->PrePartHi) == 0xFFFF)
 		    || (le16toh(part->PrePartLo) == 0xFFFF))
@@ -315,3 +325,171 @@ AMI95Extract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 
 	return TRUE;
 }
+
+/*
+ * AMI SLAB, as found in the SLAB module (0x1B) of AMI95 images.
+ */
+struct SLABEntry {
+	uint32_t DestAddr;
+	uint32_t LengthFlag;	/* bit 31 set when data is present */
+};
+
+struct SLABHeader {
+	uint16_t Entries;
+	uint16_t HeaderSize;
+	struct SLABEntry Blocks[0];
+};
+
+struct SLABName {
+	uint8_t SegType;
+	uint16_t DtorOffset;
+	char Name[0];
+};
+
+/*
+ * There is no signature, so only accept a header which describes exactly
+ * the data that follows it.
+ */
+Bool AMISLABProbe(unsigned char *Buffer, int BufferLength)
+{
+	struct SLABHeader *Header = (struct SLABHeader *)Buffer;
+	uint32_t Length, Total;
+	int i, Count, HeaderSize;
+
+	if (BufferLength < sizeof(struct SLABHeader))
+		return FALSE;
+
+	Count = le16toh(Header->Entries);
+	HeaderSize = le16toh(Header->HeaderSize);
+	if (!Count || (HeaderSize < ((Count * 8) + 4))
+	    || (HeaderSize > BufferLength))
+		return FALSE;
+
+	Total = HeaderSize;
+	for (i = 0; i < Count; i++) {
+		Length = le32toh(Header->Blocks[i].LengthFlag);
+		if (Length & 0x80000000)
+			Total += Length & 0x7FFFFFFF;
+		if (Total > BufferLength)
+			return FALSE;
+	}
+
+	return Total == BufferLength;
+}
+
+Bool
+AMISLABExtract(unsigned char *Buffer, int BufferLength, int BIOSOffset,
+	       uint32_t Offset1, uint32_t Offset2)
+{
+	struct SLABHeader *Header = (struct SLABHeader *)Buffer;
+	unsigned char *ListPointer, *DataPointer;
+	int i, Count, HeaderSize, Left, NameLength;
+
+	if (BufferLength < sizeof(struct SLABHeader)) {
+		fprintf(stderr, "Error: too small to be a SLAB file.\n");
+		return FALSE;
+	}
+
+	HeaderSize = le16toh(Header->HeaderSize);
+	Count = le16toh(Header->Entries);
+	if ((HeaderSize < ((Count * 8) + 4)) || (BufferLength < HeaderSize)) {
+		fprintf(stderr,
+			"Invalid file header - probably not a SLAB file\n");
+		return FALSE;
+	}
+	printf("%d entries\n", Count);
+
+	/* FIXME: Is the 37 really constant? */
+	if (((8 * Count) + 37) < HeaderSize) {
+		ListPointer = Buffer + 8 * Count + 37;
+		printf("Name            Tp ");
+	} else {
+		ListPointer = NULL;	/* No names present */
+		printf("Name    ");
+	}
+
+	DataPointer = Buffer + HeaderSize;
+
+	printf("LoadAddr     size initialized\n");
+
+	for (i = 0; i < Count; i++) {
+		struct SLABEntry *Block;
+		struct ModuleInfo Info;
+		char filename[25], *Name = NULL;
+		uint32_t Length;
+		Bool HasData;
+
+		if (ListPointer) {
+			struct SLABName *Entry = (struct SLABName *)ListPointer;
+
+			/* nested buffers are untrusted, check every offset */
+			Left = Buffer + BufferLength - ListPointer -
+			    sizeof(struct SLABName);
+			if (Left <= 0) {
+				fprintf(stderr, "Error: Name list runs past "
+					"the end of the file.\n");
+				return FALSE;
+			}
+
+			NameLength = strnlen(Entry->Name, Left);
+			if (NameLength == Left) {
+				fprintf(stderr, "Error: Unterminated name in "
+					"the name list.\n");
+				return FALSE;
+			}
+
+			if ((le16toh(Entry->DtorOffset) +
+			     sizeof(struct SLABEntry)) > BufferLength) {
+				fprintf(stderr, "Error: Invalid entry offset "
+					"for %s.\n", Entry->Name);
+				return FALSE;
+			}
+
+			Block = (struct SLABEntry *)(Buffer +
+						     le16toh(Entry->DtorOffset));
+			sprintf(filename, "%.20s.bin", Entry->Name);
+			Name = Entry->Name;
+			ListPointer += NameLength + 4;
+			printf("%-15s %02x ", Entry->Name, Entry->SegType);
+		} else {
+			Block = (struct SLABEntry *)(Buffer + 4 + 8 * i);
+			sprintf(filename, "block%02d.bin", i);
+			printf("block%02d ", i);
+		}
+
+		Length = le32toh(Block->LengthFlag);
+		HasData = (Length & 0x80000000) ? TRUE : FALSE;
+		Length &= 0x7FFFFFFF;
+
+		printf("%08x %8d\t %s\n", le32toh(Block->DestAddr), Length,
+		       HasData ? "yes" : "no");
+
+		if (!HasData)
+			continue;
+
+		if (Length > (Buffer + BufferLength - DataPointer)) {
+			fprintf(stderr, "Not enough data. File truncated?\n");
+			return FALSE;
+		}
+
+		Info.Offset = DataPointer - Buffer;
+		Info.PackedSize = Length;
+		Info.ExpandedSize = Length;
+		Info.Id = i;
+		Info.Type = "slab";
+		Info.Codec = CodecName(CODEC_STORED);
+		Info.Name = Name;
+		Info.Guid = NULL;
+		Info.File = filename;
+		if (ModuleWanted(&Info))
+			WriteOutputFile(filename, DataPointer, Length);
+
+		DataPointer += Length;
+	}
+
+	if (DataPointer != Buffer + BufferLength)
+		fprintf(stderr, "Warning: Unexpected %d trailing bytes",
+			(int)(Buffer + BufferLength - DataPointer));
+
+	return TRUE;
+}
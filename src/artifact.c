@@ -0,0 +1,283 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Firmware tables which end up in memory at boot: the ACPI RSDP and
+ * tables, the SMBIOS entry points, the PCI IRQ routing table and the MP
+ * floating pointer. Every decoded module is searched for all of them in
+ * one pass while it is still in memory, and those with a valid header and
+ * checksum are recorded in the manifest.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "scan.h"
+
+#define ACPI_HEADER_SIZE	36
+
+static uint8_t ArtifactSum(unsigned char *Buffer, int Length)
+{
+	uint8_t Sum = 0;
+	int i;
+
+	for (i = 0; i < Length; i++)
+		Sum += Buffer[i];
+
+	return Sum;
+}
+
+/*
+ * Copy a fixed size, space padded id string, which has to be printable.
+ */
+static Bool ArtifactIdCopy(char *String, unsigned char *Buffer, int Length)
+{
+	int i;
+
+	for (i = 0; i < Length; i++) {
+		if (!Buffer[i])
+			break;
+		if ((Buffer[i] < 0x20) || (Buffer[i] > 0x7E))
+			return FALSE;
+	}
+
+	while (i && (Buffer[i - 1] == ' '))
+		i--;
+	memcpy(String, Buffer, i);
+	String[i] = 0;
+
+	return TRUE;
+}
+
+/*
+ * The checks return the size of the artifact at the start of Buffer, or 0
+ * when it is not valid. Version and Id are at least 32 bytes.
+ */
+static int
+ArtifactRSDPCheck(unsigned char *Buffer, int Length, char *Version,
+		  char *Id)
+{
+	int Size = 20;
+
+	if ((Length < Size) || ArtifactSum(Buffer, Size))
+		return 0;
+
+	if (Buffer[15] >= 2) {
+		if (Length < 36)
+			return 0;
+		Size = le32toh(*(uint32_t *) (Buffer + 20));
+		if ((Size < 36) || (Size > Length) ||
+		    ArtifactSum(Buffer, Size))
+			return 0;
+	}
+
+	if (!ArtifactIdCopy(Id, Buffer + 9, 6))
+		return 0;
+	sprintf(Version, "%d", Buffer[15]);
+
+	return Size;
+}
+
+static int
+ArtifactACPICheck(unsigned char *Buffer, int Length, char *Version,
+		  char *Id)
+{
+	uint32_t Size;
+	int i;
+
+	if (Length < ACPI_HEADER_SIZE)
+		return 0;
+
+	Size = le32toh(*(uint32_t *) (Buffer + 4));
+	if ((Size < ACPI_HEADER_SIZE) || (Size > Length))
+		return 0;
+
+	if (!Buffer[8] || (Buffer[8] > 0x0F))
+		return 0;
+	sprintf(Version, "%d", Buffer[8]);
+
+	/* "<oem id> <oem table id>" */
+	if (!ArtifactIdCopy(Id, Buffer + 10, 6))
+		return 0;
+	i = strlen(Id);
+	Id[i++] = ' ';
+	if (!ArtifactIdCopy(Id + i, Buffer + 16, 8))
+		return 0;
+
+	if (ArtifactSum(Buffer, Size))
+		return 0;
+
+	return Size;
+}
+
+static int
+ArtifactSMBIOSCheck(unsigned char *Buffer, int Length, char *Version,
+		    char *Id)
+{
+	int Size;
+
+	if (Length < 0x1F)
+		return 0;
+
+	Size = Buffer[5];
+	if ((Size < 0x1E) || (Size > 0x20) || (Size > Length))
+		return 0;
+
+	if (memcmp(Buffer + 0x10, "_DMI_", 5) ||
+	    ArtifactSum(Buffer + 0x10, 0x0F) || ArtifactSum(Buffer, Size))
+		return 0;
+
+	sprintf(Version, "%d.%d", Buffer[6], Buffer[7]);
+
+	return Size;
+}
+
+static int
+ArtifactSMBIOS3Check(unsigned char *Buffer, int Length, char *Version,
+		     char *Id)
+{
+	int Size;
+
+	if (Length < 0x18)
+		return 0;
+
+	Size = Buffer[6];
+	if ((Size < 0x18) || (Size > Length) || ArtifactSum(Buffer, Size))
+		return 0;
+
+	sprintf(Version, "%d.%d.%d", Buffer[7], Buffer[8], Buffer[9]);
+
+	return Size;
+}
+
+static int
+ArtifactPIRCheck(unsigned char *Buffer, int Length, char *Version,
+		 char *Id)
+{
+	int Size;
+
+	if (Length < 32)
+		return 0;
+
+	Size = le16toh(*(uint16_t *) (Buffer + 6));
+	if ((le16toh(*(uint16_t *) (Buffer + 4)) != 0x0100) || (Size <= 32) ||
+	    ((Size - 32) % 16) || (Size > Length) || ArtifactSum(Buffer, Size))
+		return 0;
+
+	strcpy(Version, "1.0");
+	sprintf(Id, "router %02X:%02X.%d", Buffer[8], Buffer[9] >> 3,
+		Buffer[9] & 0x07);
+
+	return Size;
+}
+
+static int
+ArtifactMPCheck(unsigned char *Buffer, int Length, char *Version,
+		char *Id)
+{
+	if ((Length < 16) || (Buffer[8] != 1))
+		return 0;
+
+	if (((Buffer[9] != 1) && (Buffer[9] != 4)) || ArtifactSum(Buffer, 16))
+		return 0;
+
+	sprintf(Version, "1.%d", Buffer[9]);
+
+	return 16;
+}
+
+static struct ArtifactType {
+	char *Signature;
+	char *Type;
+	int (*Check) (unsigned char *Buffer, int Length, char *Version,
+		      char *Id);
+} ArtifactTypes[] = {
+	{"RSD PTR ", "rsdp", ArtifactRSDPCheck},
+	{"DSDT", "dsdt", ArtifactACPICheck},
+	{"FACP", "facp", ArtifactACPICheck},
+	{"SSDT", "ssdt", ArtifactACPICheck},
+	{"APIC", "apic", ArtifactACPICheck},
+	{"_SM_", "smbios", ArtifactSMBIOSCheck},
+	{"_SM3_", "smbios3", ArtifactSMBIOS3Check},
+	{"$PIR", "pir", ArtifactPIRCheck},
+	{"_MP_", "mp", ArtifactMPCheck},
+	{NULL, NULL, NULL}
+};
+
+/*
+ * Record the firmware tables in Buffer, which holds filename, in the
+ * manifest. Returns the number of tables found.
+ */
+int ArtifactScan(unsigned char *Buffer, int Length, char *filename)
+{
+	unsigned char Pairs[2 * SCAN_PAIRS_MAX];
+	struct ArtifactType *Type;
+	int Offset = 0, Found, Size, PairCount = 0, Count = 0;
+	char Version[32], Id[32];
+
+	if (!ManifestActive())
+		return 0;
+
+	/* the distinct two byte prefixes of the signatures */
+	for (Type = ArtifactTypes; Type->Signature; Type++) {
+		for (Found = 0; Found < PairCount; Found++)
+			if (!memcmp(Pairs + 2 * Found, Type->Signature, 2))
+				break;
+		if (Found == PairCount) {
+			memcpy(Pairs + 2 * PairCount, Type->Signature, 2);
+			PairCount++;
+		}
+	}
+
+	while (Offset < Length) {
+		Found = ScanFindPairs(Buffer + Offset, Length - Offset, Pairs,
+				      PairCount);
+		if (Found < 0)
+			break;
+		Offset += Found;
+
+		Size = 0;
+		for (Type = ArtifactTypes; Type->Signature; Type++) {
+			if ((Length - Offset) < strlen(Type->Signature))
+				continue;
+			if (memcmp(Buffer + Offset, Type->Signature,
+				   strlen(Type->Signature)))
+				continue;
+
+			Id[0] = 0;
+			Size = Type->Check(Buffer + Offset, Length - Offset,
+					   Version, Id);
+			if (Size)
+				break;
+		}
+
+		if (!Size) {
+			Offset++;
+			continue;
+		}
+
+		ManifestArtifact(filename, Offset, Size, Type->Type, Version,
+				 Id);
+		Count++;
+
+		Offset += Size;
+	}
+
+	return Count;
+}
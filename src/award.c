@@ -19,6 +19,7 @@
 #define _GNU_SOURCE 1		/* for memmem */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -26,47 +27,113 @@
 #include "compat.h"
 #include "bios_extract.h"
 #include "lh5_extract.h"
+#include "codec.h"
 
 /*
- *
+ * Returns the codec for an LZH_METHOD.
+ */
+static int AwardCodecGet(int Method)
+{
+	switch (Method) {
+	case LZH_METHOD_STORED:
+		return CODEC_STORED;
+	case LZH_METHOD_LH6:
+		return CODEC_LH6;
+	case LZH_METHOD_LH7:
+		return CODEC_LH7;
+	default:
+		return CODEC_LH5;
+	}
+}
+
+/*
+ * Award images are a string of LHA archive members, of any header level.
+ * Some are stored, newer ones use the larger windows of -lh6- and -lh7-. A
+ * member which fails to parse is skipped, the scan continues right after
+ * its method ID.
  */
 Bool
 AwardExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 	     uint32_t Offset1, uint32_t BCPSegmentOffset)
 {
-	unsigned char *p, *Buffer;
-	int HeaderSize;
+	struct ModuleInfo Info;
+	unsigned char *p, *Header, *Buffer;
+	int HeaderSize, Method, Codec;
 	unsigned int BufferSize, PackedSize;
-	char *filename;
+	char *filename, name[32];
 	unsigned short crc;
 
 	printf("Found Award BIOS.\n");
 
-	p = BIOSImage;
-	while (p) {
-		p = memmem(p, BIOSLength - (p - BIOSImage), "-lh5-", 5);
+	p = BIOSImage + 2;
+	while (p < (BIOSImage + BIOSLength)) {
+		p = memmem(p, BIOSLength - (p - BIOSImage), "-lh", 3);
 		if (!p)
 			break;
-		p -= 2;
-		HeaderSize = LH5HeaderParse(p, BIOSLength - (p - BIOSImage),
+
+		/* only bother parsing the methods we know */
+		if (((p + 5) > (BIOSImage + BIOSLength)) || (p[4] != '-') ||
+		    !p[3] || !strchr("0567", p[3])) {
+			p++;
+			continue;
+		}
+
+		Header = p - 2;
+		HeaderSize = LHAHeaderParse(Header,
+					    BIOSLength - (Header - BIOSImage),
 					    &BufferSize, &PackedSize, &filename,
-					    &crc);
-		if (!HeaderSize)
-			return FALSE;
+					    &crc, &Method);
+		if (!HeaderSize) {
+			fprintf(stderr, "Error: Skipping invalid lha header at "
+				"0x%05X\n", (unsigned int)(Header - BIOSImage));
+			p++;
+			continue;
+		}
+
+		/* level 2 headers need not name their member */
+		if (!filename[0]) {
+			free(filename);
+			snprintf(name, sizeof(name), "lha_%05X.bin",
+				 (unsigned int)(Header - BIOSImage));
+			filename = strdup(name);
+		}
+
+		Codec = AwardCodecGet(Method);
 
 		printf("0x%05X (%6d bytes)    ->    %s  \t(%6d bytes)\n",
-		       (unsigned int)(p - BIOSImage), HeaderSize + PackedSize,
+		       (unsigned int)(Header - BIOSImage), HeaderSize + PackedSize,
 		       filename, BufferSize);
 
-		Buffer = MMapOutputFile(filename, BufferSize);
-		if (!Buffer)
-			return FALSE;
+		Info.Offset = Header + HeaderSize - BIOSImage;
+		Info.PackedSize = PackedSize;
+		Info.ExpandedSize = BufferSize;
+		Info.Id = -1;
+		Info.Type = "lha";
+		Info.Codec = CodecName(Codec);
+		Info.Name = filename;
+		Info.Guid = NULL;
+		Info.File = filename;
+		if (ModuleWanted(&Info) && BufferSize) {
+			Buffer = MMapOutputFile(filename, BufferSize);
+			if (!Buffer) {
+				free(filename);
+				return FALSE;
+			}
 
-		LH5Decode(p + HeaderSize, PackedSize, Buffer, BufferSize);
+			if (CodecDecode(Codec, Header + HeaderSize, PackedSize,
+					Buffer, BufferSize,
+					CODEC_PARAMETER_DEFAULT))
+				fprintf(stderr, "Error: Failed to decode %s\n",
+					filename);
+			else if (CRC16Calculate(Buffer, BufferSize) != crc)
+				fprintf(stderr, "Warning: invalid CRC on %s\n",
+					filename);
 
-		munmap(Buffer, BufferSize);
+			CloseOutputFile(Buffer, BufferSize);
+		}
 
-		p += HeaderSize + PackedSize;
+		free(filename);
+		p = Header + HeaderSize + PackedSize;
 	}
 
 	return TRUE;
@@ -22,28 +22,43 @@
  * downloadable at http://kannegieser.net/veit/quelle/phoedeco_src.arj
  */
 /*
- * It should be very straightfoward to add support for the $COMPIBM compressed
- * bios images as well. According to Veits code, the id-string is "$COMPIBM",
- * and the data starts straight after the (not null-terminated) id-string.
+ * $COMPIBM compressed bios images are handled as well. According to Veits
+ * code, the data starts straight after the (not null-terminated) id-string.
  */
 
 #define _GNU_SOURCE 1
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
 #include <sys/mman.h>
 
 #include "compat.h"
-#include "lzss_extract.h"
+#include "bios_extract.h"
+#include "codec.h"
+
+static Bool OutputWrite(void *Private, unsigned char *Buffer, int Size)
+{
+	int fd = *(int *)Private;
+
+	if (write(fd, Buffer, Size) != Size) {
+		fprintf(stderr, "Error writing to output file: %s\n",
+			strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
 
 int main(int argc, char *argv[])
 {
 	int infd, outfd;
 	unsigned char *InputBuffer;
-	int InputBufferSize;
+	int InputBufferSize, Header;
 
 	if (argc != 3) {
 		printf("usage: %s <input file> <output file>\n", argv[0]);
@@ -72,17 +87,16 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (InputBufferSize < 0x52) {
+	if ((InputBufferSize >= 0x52) &&
+	    !strncmp((char *)InputBuffer, "BCPVPD", 7))
+		Header = 0x52;
+	else if ((InputBufferSize >= 8) &&
+		 !strncmp((char *)InputBuffer, "$COMPIBM", 8))
+		Header = 8;
+	else {
 		fprintf(stderr,
-			"Error: \"%s\" is too small tp be a BCPVPD file.\n",
-			argv[1]);
-		return 1;
-	}
-
-	if (strncmp((char *)InputBuffer, "BCPVPD", 7)) {
-		fprintf(stderr,
-			"Error: unable to find BCPVPD header in \"%s\".\n",
-			argv[1]);
+			"Error: unable to find BCPVPD or $COMPIBM header in "
+			"\"%s\".\n", argv[1]);
 		return 1;
 	}
 
@@ -93,5 +107,15 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	return LZSSExtract(InputBuffer + 0x52, InputBufferSize - 0x52, outfd);
+	/* the size is not stored, the codec measures it first */
+	if (CodecDecodeSink(CODEC_LZSS, InputBuffer + Header,
+			    InputBufferSize - Header, -1,
+			    CODEC_PARAMETER_DEFAULT, OutputWrite, &outfd)) {
+		close(outfd);
+		return 1;
+	}
+
+	close(outfd);
+
+	return 0;
 }
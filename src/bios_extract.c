@@ -19,157 +19,334 @@
 #define _GNU_SOURCE		/* memmem is useful */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <errno.h>
 #include <string.h>
+#include <getopt.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include "compat.h"
 #include "bios_extract.h"
 
+struct ExtractOptions Options;
+
+/*
+ * -fpack-struct also packs struct option, which then no longer has the
+ * layout getopt_long() expects. This is its unpacked layout, with the
+ * padding spelled out.
+ */
+struct LongOption {
+	const char *name;
+	int has_arg;
+	char pad0[sizeof(int *) - sizeof(int)];
+	int *flag;
+	int val;
+	char pad1[sizeof(int *) - sizeof(int)];
+};
+
 static void HelpPrint(char *name)
 {
 	printf("\n");
 	printf("Program to extract compressed modules from BIOS images.\n");
-	printf("Supports AMI, Award, Asus and Phoenix BIOSes.\n");
+	printf("Supports AMI, Award, Asus, Dell, HP and Phoenix BIOSes, and "
+	       "UEFI\nfirmware volumes.\n");
+	printf("\n");
+	printf("Usage:\n\t%s [options] <filename>\n", name);
+	printf("\t%s --fingerprint <filename>...\n", name);
 	printf("\n");
-	printf("Usage:\n\t%s <filename>\n", name);
+	printf("Options:\n");
+	printf("\t-s, --sparse\t\tLeave runs of 0x00 as holes in the output "
+	       "files.\n\t\t\t\tWith --manifest, runs of 0xFF are recorded "
+	       "as\n\t\t\t\textents instead of being stored.\n");
+	printf("\t-m, --manifest <file>\tWrite a manifest to <file>.\n");
+	printf("\t-l, --list\t\tOnly list the modules, do not decompress or "
+	       "write\n\t\t\t\tanything.\n");
+	printf("\t-o, --only <filter>\tOnly extract modules matching <filter>."
+	       "\n");
+	printf("\t-x, --exclude <filter>\tDo not extract modules matching "
+	       "<filter>.\n");
+	printf("\t\t\t\tA filter is a comma separated list of id=<n>[-<m>],"
+	       "\n\t\t\t\ttype=<glob>, guid=<guid>, name=<glob> and\n"
+	       "\t\t\t\tsize=[<min>]-[<max>] terms which all have to "
+	       "match.\n");
+	printf("\t-f, --fingerprint\tOnly print vendor, version and date, "
+	       "for any\n\t\t\t\tnumber of files.\n");
+	printf("\t-r, --recursive[=<depth>]\n\t\t\t\tAlso extract the "
+	       "containers found in decoded\n\t\t\t\tmodules, down to "
+	       "<depth> levels (8).\n");
+	printf("\t-c, --carve\t\tSearch the image for compressed streams "
+	       "of any\n\t\t\t\tcodec instead of identifying it.\n");
+	printf("\t-j, --jobs <n>\t\tNumber of threads for recursive "
+	       "extraction\n\t\t\t\tand carving.\n");
+	printf("\t-h, --help\t\tShow this help.\n");
 }
 
-unsigned char *MMapOutputFile(char *filename, int size)
-{
-	unsigned char *Buffer;
-	char *tmp;
-	int fd;
+/* TODO: Make bios identification more flexible */
 
-	/* all slash signs '/' in filenames will be replaced by a backslash sign '\' */
-	tmp = filename;
-	while ((tmp = strchr(tmp, '/')) != NULL)
-		tmp[0] = '\\';
+/*
+ * Entries without strings are recognised by their probe function alone,
+ * these come last.
+ */
+static struct BIOSType BIOSIdentification[] = {
+	{
+	"AMI", "AMIBOOT ROM", "AMIBIOSC", NULL, AMI95Extract}, {
+	"AMI", "$ASUSAMI$", "AMIBIOSC", NULL, AMI95Extract}, {
+	"AMI", "AMIEBBLK", "AMIBIOSC", NULL, AMI95Extract}, {
+	"AMI", "BootBlock SIO Table", "AMIBIOSC", NULL, AMI95Extract}, {
+	"Award", "Award BootBlock", "= Award Decompression Bios =", NULL,
+		    AwardExtract}, {
+	"Award", "Award Modular BIOS", "Award Software Inc", NULL,
+		    AwardExtract}, {
+	"Phoenix", "Phoenix FirstBIOS", "BCPSEGMENT", NULL, PhoenixExtract}, {
+	"Phoenix", "PhoenixBIOS 4.0", "BCPSEGMENT", NULL, PhoenixExtract}, {
+	"Phoenix", "PhoenixBIOS Version", "BCPSEGMENT", NULL,
+		    PhoenixExtract}, {
+	"Phoenix", "Phoenix ServerBIOS 3", "BCPSEGMENT", NULL,
+		    PhoenixExtract}, {
+	"Phoenix", "Phoenix TrustedCore", "BCPSEGMENT", NULL,
+		    PhoenixExtract}, {
+	"Phoenix", "Phoenix SecureCore", "BCPSEGMENT", NULL, PhoenixExtract}, {
+	"Phoenix", NULL, NULL, PhoenixLZSSProbe, PhoenixLZSSExtract}, {
+	"Dell", NULL, NULL, DellProbe, DellExtract}, {
+	"HP", NULL, NULL, HPProbe, HPExtract}, {
+	"AMI SLAB", NULL, NULL, AMISLABProbe, AMISLABExtract}, {
+	"UEFI", NULL, NULL, UEFIProbe, UEFIExtract}, {
+NULL, NULL, NULL, NULL, NULL},};
 
-	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (fd < 0) {
-		fprintf(stderr, "Error: unable to open %s: %s\n\n", filename,
-			strerror(errno));
-		return NULL;
-	}
+static unsigned char *BIOSStringFind(unsigned char *BIOSImage, int BIOSLength,
+				     char *String)
+{
+	int len = strlen(String);
 
-	/* grow file */
-	if (lseek(fd, size - 1, SEEK_SET) == -1) {
-		fprintf(stderr, "Error: Failed to grow \"%s\": %s\n", filename,
-			strerror(errno));
-		close(fd);
+	if (BIOSLength < len)
 		return NULL;
-	}
+	return memmem(BIOSImage, BIOSLength - len, String, len);
+}
 
-	if (write(fd, "", 1) != 1) {
-		fprintf(stderr, "Error: Failed to write to \"%s\": %s\n",
-			filename, strerror(errno));
-		close(fd);
-		return NULL;
-	}
+/*
+ * Returns the matching BIOSIdentification entry, or NULL.
+ */
+struct BIOSType *BIOSIdentify(unsigned char *BIOSImage, int BIOSLength,
+			      uint32_t *Offset1, uint32_t *Offset2)
+{
+	struct BIOSType *Type;
+	unsigned char *tmp;
 
-	Buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-	if (Buffer == ((void *)-1)) {
-		fprintf(stderr, "Error: Failed to mmap %s: %s\n", filename,
-			strerror(errno));
-		close(fd);
-		return NULL;
+	for (Type = BIOSIdentification; Type->Handler; Type++) {
+		if (!Type->String1) {
+			if (!Type->Probe(BIOSImage, BIOSLength))
+				continue;
+			*Offset1 = 0;
+			*Offset2 = 0;
+			return Type;
+		}
+
+		tmp = BIOSStringFind(BIOSImage, BIOSLength, Type->String1);
+		if (!tmp)
+			continue;
+		*Offset1 = tmp - BIOSImage;
+
+		tmp = BIOSStringFind(BIOSImage, BIOSLength, Type->String2);
+		if (!tmp)
+			continue;
+		*Offset2 = tmp - BIOSImage;
+
+		return Type;
 	}
 
-	close(fd);
+	return NULL;
+}
 
-	return Buffer;
+char *BIOSVendorIdentify(unsigned char *BIOSImage, int BIOSLength)
+{
+	struct BIOSType *Type;
+	uint32_t Offset1, Offset2;
+
+	Type = BIOSIdentify(BIOSImage, BIOSLength, &Offset1, &Offset2);
+	if (!Type)
+		return NULL;
+	return Type->Vendor;
 }
 
-/* TODO: Make bios identification more flexible */
+/*
+ * Format a raw, mixed endian, GUID the way the specifications write it.
+ */
+void GuidString(char *guid, unsigned char *raw)
+{
+	sprintf(guid, "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+		le32toh(*(uint32_t *) raw), le16toh(*(uint16_t *) (raw + 4)),
+		le16toh(*(uint16_t *) (raw + 6)), raw[8], raw[9], raw[10],
+		raw[11], raw[12], raw[13], raw[14], raw[15]);
+}
 
-static struct {
-	char *String1;
-	char *String2;
-	 Bool(*Handler) (unsigned char *Image, int ImageLength, int ImageOffset,
-			 uint32_t Offset1, uint32_t Offset2);
-} BIOSIdentification[] = {
-	{
-	"AMIBOOT ROM", "AMIBIOSC", AMI95Extract}, {
-	"$ASUSAMI$", "AMIBIOSC", AMI95Extract}, {
-	"AMIEBBLK", "AMIBIOSC", AMI95Extract}, {
-	"BootBlock SIO Table", "AMIBIOSC", AMI95Extract}, {
-	"Award BootBlock", "= Award Decompression Bios =", AwardExtract}, {
-	"Award Modular BIOS", "Award Software Inc", AwardExtract}, {
-	"Phoenix FirstBIOS", "BCPSEGMENT", PhoenixExtract}, {
-	"PhoenixBIOS 4.0", "BCPSEGMENT", PhoenixExtract}, {
-	"PhoenixBIOS Version", "BCPSEGMENT", PhoenixExtract}, {
-	"Phoenix ServerBIOS 3", "BCPSEGMENT", PhoenixExtract}, {
-	"Phoenix TrustedCore", "BCPSEGMENT", PhoenixExtract}, {
-	"Phoenix SecureCore", "BCPSEGMENT", PhoenixExtract}, {
-NULL, NULL, NULL},};
+/*
+ * Run the handler for an identified image, which is taken to end at 1MB.
+ */
+Bool
+BIOSExtract(struct BIOSType *Type, unsigned char *BIOSImage, int BIOSLength,
+	    uint32_t Offset1, uint32_t Offset2)
+{
+	uint32_t BIOSOffset = (0x100000 - BIOSLength) & 0xFFFFF;
+
+	return Type->Handler(BIOSImage, BIOSLength, BIOSOffset, Offset1,
+			     Offset2);
+}
 
 int main(int argc, char *argv[])
 {
 	int FileLength = 0;
-	uint32_t BIOSOffset = 0;
 	unsigned char *BIOSImage = NULL;
+	struct BIOSType *Type;
 	int fd;
 	uint32_t Offset1, Offset2;
-	int i, len;
-	unsigned char *tmp;
+	int i, c;
+	char *filename;
+	Bool ret, Fingerprint = FALSE;
+
+	static struct LongOption LongOptions[] = {
+		{.name = "sparse", .has_arg = no_argument, .val = 's'},
+		{.name = "manifest", .has_arg = required_argument, .val = 'm'},
+		{.name = "list", .has_arg = no_argument, .val = 'l'},
+		{.name = "only", .has_arg = required_argument, .val = 'o'},
+		{.name = "exclude", .has_arg = required_argument, .val = 'x'},
+		{.name = "fingerprint", .has_arg = no_argument, .val = 'f'},
+		{.name = "recursive", .has_arg = optional_argument, .val = 'r'},
+		{.name = "carve", .has_arg = no_argument, .val = 'c'},
+		{.name = "jobs", .has_arg = required_argument, .val = 'j'},
+		{.name = "help", .has_arg = no_argument, .val = 'h'},
+		{}
+	};
+
+	while ((c = getopt_long(argc, argv, "sm:lo:x:fr::cj:h",
+				 (struct option *)LongOptions, NULL)) != -1) {
+		switch (c) {
+		case 's':
+			Options.Sparse = TRUE;
+			break;
+		case 'm':
+			if (!ManifestOpen(optarg))
+				return 1;
+			break;
+		case 'l':
+			Options.List = TRUE;
+			break;
+		case 'o':
+			if (!FilterAdd(optarg, FALSE))
+				return 1;
+			break;
+		case 'x':
+			if (!FilterAdd(optarg, TRUE))
+				return 1;
+			break;
+		case 'f':
+			Fingerprint = TRUE;
+			break;
+		case 'r':
+			Options.Depth = optarg ? atoi(optarg) : 8;
+			if (Options.Depth < 1) {
+				fprintf(stderr, "Error: Invalid depth \"%s\"\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'c':
+			Options.Carve = TRUE;
+			break;
+		case 'j':
+			Options.Jobs = atoi(optarg);
+			if (Options.Jobs < 1) {
+				fprintf(stderr,
+					"Error: Invalid number of jobs \"%s\"\n",
+					optarg);
+				return 1;
+			}
+			break;
+		default:
+			HelpPrint(argv[0]);
+			return 1;
+		}
+	}
+
+	if (Fingerprint && (optind < argc)) {
+		ret = TRUE;
+		for (i = optind; i < argc; i++)
+			if (!BIOSFingerprint(argv[i]))
+				ret = FALSE;
+		return ret ? 0 : 1;
+	}
 
-	if ((argc != 2) || !strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+	if (optind != (argc - 1)) {
 		HelpPrint(argv[0]);
 		return 1;
 	}
+	filename = argv[optind];
 
-	fd = open(argv[1], O_RDONLY);
+	fd = open(filename, O_RDONLY);
 	if (fd < 0) {
-		fprintf(stderr, "Error: Failed to open %s: %s\n", argv[1],
+		fprintf(stderr, "Error: Failed to open %s: %s\n", filename,
 			strerror(errno));
 		return 1;
 	}
 
 	FileLength = lseek(fd, 0, SEEK_END);
 	if (FileLength < 0) {
-		fprintf(stderr, "Error: Failed to lseek \"%s\": %s\n", argv[1],
+		fprintf(stderr, "Error: Failed to lseek \"%s\": %s\n", filename,
 			strerror(errno));
 		return 1;
 	}
 
-	BIOSOffset = (0x100000 - FileLength) & 0xFFFFF;
-
 	BIOSImage = mmap(NULL, FileLength, PROT_READ, MAP_PRIVATE, fd, 0);
 	if (BIOSImage < 0) {
-		fprintf(stderr, "Error: Failed to mmap %s: %s\n", argv[1],
+		fprintf(stderr, "Error: Failed to mmap %s: %s\n", filename,
 			strerror(errno));
 		return 1;
 	}
 
-	printf("Using file \"%s\" (%ukB)\n", argv[1], FileLength >> 10);
+	printf("Using file \"%s\" (%ukB)\n", filename, FileLength >> 10);
 
-	for (i = 0; BIOSIdentification[i].Handler; i++) {
-		len = strlen(BIOSIdentification[i].String1);
-		tmp =
-		    memmem(BIOSImage, FileLength - len,
-			   BIOSIdentification[i].String1, len);
-		if (!tmp)
-			continue;
-		Offset1 = tmp - BIOSImage;
+	/* the image as a whole is scanned here, its slices are not */
+	MicrocodeScan(BIOSImage, FileLength, filename);
+	ArtifactScan(BIOSImage, FileLength, filename);
+	OutputContainerSet(BIOSImage, FileLength);
 
-		len = strlen(BIOSIdentification[i].String2);
-		tmp =
-		    memmem(BIOSImage, FileLength - len,
-			   BIOSIdentification[i].String2, len);
-		if (!tmp)
-			continue;
-		Offset2 = tmp - BIOSImage;
+	/* capsules are extracted from behind their header, in place */
+	BIOSImage += CapsuleBody(BIOSImage, FileLength, &FileLength);
 
-		if (BIOSIdentification[i].Handler
-		    (BIOSImage, FileLength, BIOSOffset, Offset1, Offset2))
-			return 0;
-		else
-			return 1;
+	/* of a full flash dump, only the BIOS region is of interest */
+	BIOSImage += DescriptorBIOSRegion(BIOSImage, FileLength, &FileLength);
+
+	if (Options.Carve)
+		Type = NULL;
+	else
+		Type = BIOSIdentify(BIOSImage, FileLength, &Offset1, &Offset2);
+
+	if (!Type && !Options.Carve) {
+		fprintf(stderr, "Error: Unable to detect BIOS Image type.\n");
+		fprintf(stderr, "Use --carve to search it for compressed "
+			"streams.\n");
+		ManifestClose();
+		return 1;
 	}
 
-	fprintf(stderr, "Error: Unable to detect BIOS Image type.\n");
-	return 1;
+	if (Options.Depth)
+		RecurseStart();
+
+	/* microcode and ACMs of modern Intel images, when listed */
+	FITExtract(BIOSImage, FileLength);
+
+	if (Type)
+		ret = BIOSExtract(Type, BIOSImage, FileLength, Offset1, Offset2);
+	else
+		ret = CarveExtract(BIOSImage, FileLength);
+
+	if (Options.Depth)
+		RecurseRun();
+
+	ManifestClose();
+	if (ret)
+		return 0;
+	else
+		return 1;
 }
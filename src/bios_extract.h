@@ -35,18 +35,134 @@
 #endif
 
 /* bios_extract.c */
+struct ExtractOptions {
+	Bool Sparse;		/* leave runs of 0x00 as holes in output files */
+	Bool List;		/* only walk the module headers */
+	int Depth;		/* levels of nested containers to extract */
+	int Jobs;		/* threads for recursive extraction and carving */
+	Bool Carve;		/* search for streams instead of walking the image */
+};
+
+extern struct ExtractOptions Options;
+
+struct BIOSType {
+	char *Vendor;
+	char *String1;
+	char *String2;
+	 Bool(*Probe) (unsigned char *Image, int ImageLength);
+	 Bool(*Handler) (unsigned char *Image, int ImageLength, int ImageOffset,
+			 uint32_t Offset1, uint32_t Offset2);
+};
+
+struct BIOSType *BIOSIdentify(unsigned char *BIOSImage, int BIOSLength,
+			      uint32_t *Offset1, uint32_t *Offset2);
+Bool BIOSExtract(struct BIOSType *Type, unsigned char *BIOSImage,
+		 int BIOSLength, uint32_t Offset1, uint32_t Offset2);
+char *BIOSVendorIdentify(unsigned char *BIOSImage, int BIOSLength);
+void GuidString(char *guid, unsigned char *raw);
+
+/* capsule.c */
+int CapsuleBody(unsigned char *Image, int Length, int *BodyLength);
+
+/* descriptor.c */
+int DescriptorBIOSRegion(unsigned char *Image, int Length, int *BIOSLength);
+
+/* fit.c */
+Bool FITExtract(unsigned char *Image, int Length);
+
+/* microcode.c */
+int MicrocodeScan(unsigned char *Buffer, int Length, char *filename);
+
+/* artifact.c */
+int ArtifactScan(unsigned char *Buffer, int Length, char *filename);
+
+/* output.c */
 unsigned char *MMapOutputFile(char *filename, int size);
+void CloseOutputFile(unsigned char *Buffer, int size);
+Bool WriteOutputFile(char *filename, unsigned char *Buffer, int size);
+void OutputDirectorySet(char *Directory);
+char *OutputDirectoryGet(void);
+void OutputContainerSet(unsigned char *Buffer, int Length);
+void OutputHookSet(void (*Hook) (char *filename, unsigned char *Buffer,
+				 int size));
+
+/* recurse.c */
+void RecurseStart(void);
+Bool RecurseRun(void);
+
+/* parallel.c */
+int ParallelJobs(void);
+void ParallelRun(int Count, void (*Work) (void *Private, int Index),
+		 void *Private);
+
+/* carve.c */
+Bool CarveExtract(unsigned char *BIOSImage, int BIOSLength);
+
+/* fingerprint.c */
+Bool BIOSFingerprint(char *filename);
+
+/* manifest.c */
+/* A module as found while walking the image, before it gets decoded. */
+struct ModuleInfo {
+	uint32_t Offset;	/* of the packed data in the image */
+	uint32_t PackedSize;
+	uint32_t ExpandedSize;
+	int Id;			/* -1 when the format has no module id */
+	char *Type;
+	char *Codec;
+	char *Name;
+	char *Guid;
+	char *File;
+};
+
+Bool ManifestOpen(char *filename);
+void ManifestClose(void);
+Bool ManifestActive(void);
+void ManifestModule(struct ModuleInfo *Module);
+void ManifestExtent(char *filename, uint32_t Offset, uint32_t Length,
+		    uint8_t Fill);
+void ManifestMicrocode(char *filename, uint32_t Offset, uint32_t Size,
+		       char *Vendor, uint32_t Signature, uint32_t Revision,
+		       char *Date, uint32_t Flags);
+void ManifestArtifact(char *filename, uint32_t Offset, uint32_t Size,
+		      char *Type, char *Version, char *Id);
+
+/* filter.c */
+Bool FilterAdd(char *Spec, Bool Exclude);
+Bool ModuleSelected(struct ModuleInfo *Module);
+Bool ModuleWanted(struct ModuleInfo *Module);
 
 /* ami.c */
 Bool AMI95Extract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 		  uint32_t Offset1, uint32_t Offset2);
+Bool AMISLABProbe(unsigned char *Buffer, int BufferLength);
+Bool AMISLABExtract(unsigned char *Buffer, int BufferLength, int BIOSOffset,
+		    uint32_t Offset1, uint32_t Offset2);
 
 /* phoenix.c */
 Bool PhoenixExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 		    uint32_t Offset1, uint32_t Offset2);
+Bool PhoenixLZSSProbe(unsigned char *BIOSImage, int BIOSLength);
+Bool PhoenixLZSSExtract(unsigned char *BIOSImage, int BIOSLength,
+			int BIOSOffset, uint32_t Offset1, uint32_t Offset2);
+
+/* dell.c */
+Bool DellProbe(unsigned char *BIOSImage, int BIOSLength);
+Bool DellExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
+		 uint32_t Offset1, uint32_t Offset2);
+
+/* hp.c */
+Bool HPProbe(unsigned char *BIOSImage, int BIOSLength);
+Bool HPExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
+	       uint32_t Offset1, uint32_t Offset2);
 
 /* award.c */
 Bool AwardExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 		  uint32_t Offset1, uint32_t Offset2);
 
+/* uefi.c */
+Bool UEFIProbe(unsigned char *Image, int Length);
+Bool UEFIExtract(unsigned char *Image, int Length, int ImageOffset,
+		 uint32_t Offset1, uint32_t Offset2);
+
 #endif				/* BIOS_EXTRACT_H */
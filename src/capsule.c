@@ -0,0 +1,124 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Capsules, as firmware updates are usually shipped. A capsule header in
+ * front of the flash image only tells where the image starts and how large
+ * it is, so the image is used in place, right behind the header.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+
+enum CapsuleLayout {
+	CAPSULE_UEFI,		/* EFI_CAPSULE_HEADER */
+	CAPSULE_FRAMEWORK,	/* with an offset to the body */
+	CAPSULE_APTIO,		/* with an offset to the rom image */
+	CAPSULE_TOSHIBA,
+};
+
+static struct CapsuleType {
+	char *Name;
+	unsigned char Guid[16];
+	enum CapsuleLayout Layout;
+} CapsuleTypes[] = {
+	{"EFI", {0xBD, 0x86, 0x66, 0x3B, 0x76, 0x0D, 0x30, 0x40,
+		 0xB7, 0x0E, 0xB5, 0x51, 0x9E, 0x2F, 0xC5, 0xA0},
+	 CAPSULE_FRAMEWORK},
+	{"UEFI FMP", {0xED, 0xD5, 0xCB, 0x6D, 0x2D, 0xE8, 0x44, 0x4C,
+		      0xBD, 0xA1, 0x71, 0x94, 0x19, 0x9A, 0xD9, 0x2A},
+	 CAPSULE_UEFI},
+	{"Intel", {0xB9, 0x82, 0x91, 0x53, 0xB5, 0xAB, 0x91, 0x43,
+		   0xB6, 0x9A, 0xE3, 0xA9, 0x43, 0xF7, 0x2F, 0xCC},
+	 CAPSULE_UEFI},
+	{"Lenovo", {0xD3, 0xAF, 0x0B, 0xE2, 0x14, 0x99, 0x4F, 0x4F,
+		    0x95, 0x37, 0x31, 0x29, 0xE0, 0x90, 0xEB, 0x3C},
+	 CAPSULE_UEFI},
+	{"Lenovo", {0x76, 0xFE, 0xB5, 0x25, 0x43, 0x82, 0x5C, 0x4A,
+		    0xA9, 0xBD, 0x7E, 0xE3, 0x24, 0x61, 0x98, 0xB5},
+	 CAPSULE_UEFI},
+	{"AMI Aptio signed", {0x8B, 0xA6, 0x3C, 0x4A, 0x23, 0x77, 0xFB, 0x48,
+			      0x80, 0x3D, 0x57, 0x8C, 0xC1, 0xFE, 0xC4, 0x4D},
+	 CAPSULE_APTIO},
+	{"AMI Aptio", {0x90, 0xBB, 0xEE, 0x14, 0x0A, 0x89, 0xDB, 0x43,
+		       0xAE, 0xD1, 0x5D, 0x3C, 0x45, 0x88, 0xA4, 0x18},
+	 CAPSULE_APTIO},
+	{"Toshiba", {0x62, 0x70, 0xE0, 0x3B, 0x51, 0x1D, 0xD2, 0x45,
+		     0x83, 0x2B, 0xF0, 0x93, 0x25, 0x7E, 0xD4, 0x61},
+	 CAPSULE_TOSHIBA},
+	{NULL}
+};
+
+/*
+ * Returns the offset of the image in a capsule, or 0 when Image does not
+ * start with a known capsule header. *BodyLength is set to the length of
+ * the image.
+ */
+int CapsuleBody(unsigned char *Image, int Length, int *BodyLength)
+{
+	struct CapsuleType *Type;
+	uint32_t Offset, Size;
+
+	if (Length < 0x50)
+		return 0;
+
+	for (Type = CapsuleTypes; Type->Name; Type++)
+		if (!memcmp(Image, Type->Guid, 16))
+			break;
+	if (!Type->Name)
+		return 0;
+
+	/* all start with the guid and the header size */
+	Offset = le32toh(*(uint32_t *) (Image + 0x10));
+
+	switch (Type->Layout) {
+	case CAPSULE_FRAMEWORK:
+		if (le32toh(*(uint32_t *) (Image + 0x34)))
+			Offset = le32toh(*(uint32_t *) (Image + 0x34));
+		Size = le32toh(*(uint32_t *) (Image + 0x18));
+		break;
+	case CAPSULE_APTIO:
+		Offset = le16toh(*(uint16_t *) (Image + 0x1C));
+		Size = le32toh(*(uint32_t *) (Image + 0x18));
+		break;
+	case CAPSULE_TOSHIBA:
+		Size = le32toh(*(uint32_t *) (Image + 0x14));
+		break;
+	default:
+		Size = le32toh(*(uint32_t *) (Image + 0x18));
+		break;
+	}
+
+	if ((Offset < 0x1C) || (Offset >= Length)) {
+		fprintf(stderr, "Warning: Invalid %s capsule header, ignored.\n",
+			Type->Name);
+		return 0;
+	}
+
+	/* the capsule size includes the header, and might be missing */
+	if ((Size <= Offset) || (Size > Length))
+		Size = Length;
+	*BodyLength = Size - Offset;
+
+	printf("%s capsule, image at 0x%X (%ukB)\n", Type->Name, Offset,
+	       *BodyLength >> 10);
+
+	return Offset;
+}
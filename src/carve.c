@@ -0,0 +1,396 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Vendor agnostic carving. Rather than walking a known layout, the image
+ * is searched for the headers of every codec which describes its own
+ * stream: lha members, EFI 1.1/Tiano streams and LZMA streams. Candidates
+ * have to pass cheap tests first (header checksums, sane sizes, a valid
+ * code table for the first block), only the survivors which the filters
+ * select get decoded, in parallel batches which are written out in order.
+ * The outputs and manifest records are keyed by the offset of the stream
+ * in the image.
+ *
+ * The other codecs (LZSS, LZARI, Dell, HP) have no header of their own to
+ * search for, they are only found through the vendor handlers.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+#include "lh5_extract.h"
+#include "efi_extract.h"
+#include "lzma_extract.h"
+
+/* anything larger than this is taken to be a chance match */
+#define CARVE_SIZE_MAX 0x4000000
+
+struct CarveCandidate {
+	uint32_t Offset;	/* of the header */
+	uint32_t HeaderSize;	/* 0 when the codec parses the header itself */
+	uint32_t PackedSize;
+	uint32_t ExpandedSize;
+	int Codec;
+	char *Name;
+	Bool Batched;		/* selected for decoding */
+	unsigned char *Buffer;	/* decoded data */
+};
+
+static struct CarveCandidate *Candidates;
+static int CandidateCount, CandidateSize;
+
+static unsigned char *CarveImage;
+
+static struct CarveCandidate *CandidateAdd(void)
+{
+	struct CarveCandidate *New;
+
+	if (CandidateCount == CandidateSize) {
+		New = realloc(Candidates, (CandidateSize + 64) *
+			      sizeof(struct CarveCandidate));
+		if (!New) {
+			fprintf(stderr, "Error: Out of memory for %d "
+				"candidates\n", CandidateSize + 64);
+			return NULL;
+		}
+		Candidates = New;
+		CandidateSize += 64;
+	}
+
+	New = Candidates + CandidateCount++;
+	memset(New, 0, sizeof(struct CarveCandidate));
+	return New;
+}
+
+static int CarveLHACodecGet(int Method)
+{
+	switch (Method) {
+	case LZH_METHOD_STORED:
+		return CODEC_STORED;
+	case LZH_METHOD_LH6:
+		return CODEC_LH6;
+	case LZH_METHOD_LH7:
+		return CODEC_LH7;
+	default:
+		return CODEC_LH5;
+	}
+}
+
+/*
+ * lha members are found through their method ID, which sits 2 bytes into
+ * the header.
+ */
+static Bool CarveLHAScan(unsigned char *Image, int Length)
+{
+	struct CarveCandidate *Candidate;
+	unsigned int HeaderSize, PackedSize, ExpandedSize;
+	unsigned short crc;
+	unsigned char *p = Image + 2;
+	char *Name;
+	int Method;
+
+	while ((p = memmem(p, Length - (p - Image), "-lh", 3))) {
+		if (!LHAHeaderCheck(p - 2, Length - (p - 2 - Image))) {
+			p++;
+			continue;
+		}
+
+		HeaderSize = LHAHeaderParse(p - 2, Length - (p - 2 - Image),
+					    &ExpandedSize, &PackedSize, &Name,
+					    &crc, &Method);
+		if (!HeaderSize || !ExpandedSize ||
+		    (ExpandedSize > CARVE_SIZE_MAX) ||
+		    ((Method == LZH_METHOD_STORED) &&
+		     (PackedSize != ExpandedSize))) {
+			if (HeaderSize)
+				free(Name);
+			p++;
+			continue;
+		}
+
+		Candidate = CandidateAdd();
+		if (!Candidate) {
+			free(Name);
+			return FALSE;
+		}
+		Candidate->Offset = p - 2 - Image;
+		Candidate->HeaderSize = HeaderSize;
+		Candidate->PackedSize = PackedSize;
+		Candidate->ExpandedSize = ExpandedSize;
+		Candidate->Codec = CarveLHACodecGet(Method);
+		Candidate->Name = Name;
+
+		/* nothing to be found inside packed data */
+		p += HeaderSize + PackedSize;
+		if ((p - Image) >= Length)
+			break;
+	}
+
+	return TRUE;
+}
+
+/*
+ * EFI 1.1 and Tiano streams only have their sizes in the header, so every
+ * offset is tried. The sizes have to fit the image and each other, which
+ * rules out most offsets right away, then the code tables of the first
+ * block have to be complete.
+ */
+static Bool CarveEFIScan(unsigned char *Image, int Length)
+{
+	struct CarveCandidate *Candidate;
+	unsigned int PackedSize, ExpandedSize;
+	int Offset;
+
+	for (Offset = 0; Offset <= (Length - 12); Offset++) {
+		if (!EFIHeaderParse(Image + Offset, Length - Offset,
+				    &ExpandedSize, &PackedSize))
+			continue;
+
+		if ((PackedSize < 4) || !ExpandedSize ||
+		    (ExpandedSize > CARVE_SIZE_MAX))
+			continue;
+
+		/* lzh never grows data by more than a little */
+		if (PackedSize > (ExpandedSize + (ExpandedSize >> 3) + 0x40))
+			continue;
+
+		/* the first block size */
+		if (!Image[Offset + 8] && !Image[Offset + 9])
+			continue;
+
+		if (LZHEFIMethodDetect(Image + Offset + 8, PackedSize) == -1)
+			continue;
+
+		Candidate = CandidateAdd();
+		if (!Candidate)
+			return FALSE;
+		Candidate->Offset = Offset;
+		Candidate->PackedSize = PackedSize + 8;
+		Candidate->ExpandedSize = ExpandedSize;
+		Candidate->Codec = CODEC_EFI;
+	}
+
+	return TRUE;
+}
+
+/*
+ * LZMA streams do not tell their packed size, that is only known once
+ * they are decoded. Streams which end with an end marker do not tell their
+ * expanded size either, that is left for decoding too, which gives up once
+ * they grow past CARVE_SIZE_MAX.
+ */
+static Bool CarveLZMAScan(unsigned char *Image, int Length)
+{
+	struct CarveCandidate *Candidate;
+	unsigned int ExpandedSize, DictionarySize;
+	int Offset = 0;
+
+	while ((Offset = LZMAScan(Image, Length, Offset)) != -1) {
+		LZMAHeaderParse(Image + Offset, Length - Offset, &ExpandedSize,
+				&DictionarySize);
+		if ((ExpandedSize != LZMA_SIZE_UNKNOWN) &&
+		    (ExpandedSize > CARVE_SIZE_MAX)) {
+			Offset++;
+			continue;
+		}
+
+		Candidate = CandidateAdd();
+		if (!Candidate)
+			return FALSE;
+		Candidate->Offset = Offset;
+		Candidate->PackedSize = Length - Offset;
+		Candidate->ExpandedSize = ExpandedSize;
+		Candidate->Codec = CODEC_LZMA;
+
+		Offset++;
+	}
+
+	return TRUE;
+}
+
+static int CandidateCompare(const void *A, const void *B)
+{
+	const struct CarveCandidate *a = A, *b = B;
+
+	if (a->Offset != b->Offset)
+		return (a->Offset < b->Offset) ? -1 : 1;
+	return a->Codec - b->Codec;
+}
+
+static void CandidateInfo(struct CarveCandidate *Candidate,
+			  struct ModuleInfo *Info, char *filename)
+{
+	Info->Offset = Candidate->Offset + Candidate->HeaderSize;
+	Info->PackedSize = Candidate->PackedSize;
+	Info->ExpandedSize = Candidate->ExpandedSize;
+	Info->Id = -1;
+	Info->Type = "carve";
+	Info->Codec = CodecName(Candidate->Codec);
+	Info->Name = Candidate->Name;
+	Info->Guid = NULL;
+	Info->File = filename;
+}
+
+/*
+ * Private holds the indices of the candidates in the batch.
+ */
+static void CandidateDecode(void *Private, int Index)
+{
+	struct CarveCandidate *Candidate = &Candidates[((int *)Private)[Index]];
+	unsigned char *Packed = CarveImage + Candidate->Offset +
+	    Candidate->HeaderSize;
+	unsigned char *Buffer;
+	int ret, Size = Candidate->ExpandedSize;
+
+	if (Candidate->ExpandedSize == LZMA_SIZE_UNKNOWN)
+		Size = -1;
+
+	/* for LZMA, this also tells how long the stream really is */
+	ret = CodecDecodeAlloc(Candidate->Codec, Packed, Candidate->PackedSize,
+			       &Buffer, &Size, CARVE_SIZE_MAX,
+			       CODEC_PARAMETER_DEFAULT);
+	if (ret <= 0)
+		return;
+
+	Candidate->Buffer = Buffer;
+	Candidate->PackedSize = ret;
+	Candidate->ExpandedSize = Size;
+}
+
+/*
+ * Search the whole image for compressed streams, and decode what is found.
+ * Streams which start inside one that decoded are chance matches in its
+ * packed data, and are dropped before decoding. Decoding happens in
+ * batches of one stream per job, so that only a batch worth of decoded
+ * data is held at any time. A batch ends early at a stream inside another
+ * one of the batch, which only gets decided on once that one is decoded.
+ */
+Bool CarveExtract(unsigned char *BIOSImage, int BIOSLength)
+{
+	struct CarveCandidate *Candidate;
+	struct ModuleInfo Info;
+	uint32_t End = 0, BatchEnd;
+	char filename[32];
+	int i, j, Jobs, BatchCount, *Batch, Found = 0, Skipped = 0;
+	Bool ret = TRUE;
+
+	CarveImage = BIOSImage;
+
+	if (!CarveLHAScan(BIOSImage, BIOSLength) ||
+	    !CarveEFIScan(BIOSImage, BIOSLength) ||
+	    !CarveLZMAScan(BIOSImage, BIOSLength))
+		ret = FALSE;
+
+	qsort(Candidates, CandidateCount, sizeof(struct CarveCandidate),
+	      CandidateCompare);
+
+	printf("Found %d candidate streams.\n", CandidateCount);
+
+	Jobs = ParallelJobs();
+	Batch = malloc(Jobs * sizeof(int));
+	if (!Batch) {
+		fprintf(stderr, "Error: Out of memory for %d jobs\n", Jobs);
+		Jobs = 0;
+		ret = FALSE;
+	}
+
+	for (i = 0; (i < CandidateCount) && Jobs; i = j) {
+		/* the next streams which are wanted, and not inside another */
+		BatchCount = 0;
+		BatchEnd = 0;
+		for (j = i; (j < CandidateCount) && (BatchCount < Jobs); j++) {
+			Candidate = &Candidates[j];
+			if (Candidate->Offset < End)
+				continue;
+
+			/* wait for whether the one it is inside decodes */
+			if (Candidate->Offset < BatchEnd)
+				break;
+
+			CandidateInfo(Candidate, &Info, filename);
+			if (!ModuleSelected(&Info)) {
+				Skipped++;
+				continue;
+			}
+
+			Candidate->Batched = TRUE;
+			Batch[BatchCount++] = j;
+
+			/* LZMA sizes are only known after decoding */
+			if ((Candidate->Codec != CODEC_LZMA) &&
+			    ((Candidate->Offset + Candidate->HeaderSize +
+			      Candidate->PackedSize) > BatchEnd))
+				BatchEnd = Candidate->Offset +
+				    Candidate->HeaderSize + Candidate->PackedSize;
+		}
+
+		if (!Options.List)
+			ParallelRun(BatchCount, CandidateDecode, Batch);
+
+		for (; i < j; i++) {
+			Candidate = &Candidates[i];
+
+			if (!Candidate->Batched || (Candidate->Offset < End) ||
+			    (!Options.List && !Candidate->Buffer)) {
+				free(Candidate->Buffer);
+				free(Candidate->Name);
+				continue;
+			}
+
+			/* LZMA sizes are only known after decoding */
+			if (!Options.List || (Candidate->Codec != CODEC_LZMA))
+				End = Candidate->Offset + Candidate->HeaderSize +
+				    Candidate->PackedSize;
+
+			snprintf(filename, sizeof(filename), "carve_%08X.%s",
+				 Candidate->Offset, CodecName(Candidate->Codec));
+
+			printf("0x%08X (%7d bytes)    ->    %s  \t(%7d bytes)\n",
+			       Candidate->Offset,
+			       Candidate->HeaderSize + Candidate->PackedSize,
+			       filename, Candidate->ExpandedSize);
+
+			CandidateInfo(Candidate, &Info, filename);
+			if (ModuleWanted(&Info) &&
+			    !WriteOutputFile(filename, Candidate->Buffer,
+					     Candidate->ExpandedSize))
+				ret = FALSE;
+
+			Found++;
+			free(Candidate->Buffer);
+			free(Candidate->Name);
+		}
+	}
+
+	free(Batch);
+	free(Candidates);
+	Candidates = NULL;
+	CandidateCount = CandidateSize = 0;
+
+	if (!Found && !Skipped) {
+		fprintf(stderr, "Error: No compressed streams found.\n");
+		return FALSE;
+	}
+
+	return ret;
+}
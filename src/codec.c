@@ -0,0 +1,318 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * All decoders, behind one interface. Handlers pick a codec by its id, and
+ * anything which needs to treat codecs alike (recursion, statistics,
+ * testing) can go through the table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+#include "lh5_extract.h"
+#include "lzss_extract.h"
+#include "lzari_extract.h"
+#include "efi_extract.h"
+#include "lzma_extract.h"
+#include "dell_extract.h"
+#include "hp_extract.h"
+
+static int
+StoredDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+	     int OutputSize, int Parameter)
+{
+	if (OutputSize > InputSize)
+		return -1;
+	memcpy(Output, Input, OutputSize);
+	return 0;
+}
+
+static int StoredSize(unsigned char *Input, int InputSize, int Parameter)
+{
+	return InputSize;
+}
+
+static int
+LH5CodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+	       int OutputSize, int Parameter)
+{
+	return LZHDecode(Input, InputSize, Output, OutputSize, LZH_METHOD_LH5);
+}
+
+static int
+LH6CodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+	       int OutputSize, int Parameter)
+{
+	return LZHDecode(Input, InputSize, Output, OutputSize, LZH_METHOD_LH6);
+}
+
+static int
+LH7CodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+	       int OutputSize, int Parameter)
+{
+	return LZHDecode(Input, InputSize, Output, OutputSize, LZH_METHOD_LH7);
+}
+
+static unsigned char LZSSFill(int Parameter)
+{
+	if (Parameter == CODEC_PARAMETER_DEFAULT)
+		return LZSS_FILL;
+	return Parameter;
+}
+
+static int
+LZSSCodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+		int OutputSize, int Parameter)
+{
+	if (LZSSDecode(Input, InputSize, Output, OutputSize,
+		       LZSSFill(Parameter), LZSS_THRESHOLD) != OutputSize)
+		return -1;
+	return 0;
+}
+
+static int LZSSSize(unsigned char *Input, int InputSize, int Parameter)
+{
+	return LZSSDecode(Input, InputSize, NULL, 0, LZSSFill(Parameter),
+			  LZSS_THRESHOLD);
+}
+
+static int
+LZARICodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+		 int OutputSize, int Parameter)
+{
+	return LZARIDecode(Input, InputSize, Output, OutputSize);
+}
+
+static int
+LZINTCodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+		 int OutputSize, int Parameter)
+{
+	return LZINTDecode(Input, InputSize, Output, OutputSize);
+}
+
+/* LZINT and EFI streams share the header */
+static int EFISize(unsigned char *Input, int InputSize, int Parameter)
+{
+	unsigned int original_size, packed_size;
+
+	if (!EFIHeaderParse(Input, InputSize, &original_size, &packed_size))
+		return -1;
+	return original_size;
+}
+
+static int
+EFICodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+	       int OutputSize, int Parameter)
+{
+	if (Parameter == CODEC_PARAMETER_DEFAULT)
+		Parameter = EFI_COMPRESSION_DETECT;
+	return EFIDecode(Input, InputSize, Output, OutputSize, Parameter);
+}
+
+static int LZMASize(unsigned char *Input, int InputSize, int Parameter)
+{
+	return LZMAExpandedSize(Input, InputSize, NULL, 0);
+}
+
+static int
+LZMACodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+		int OutputSize, int Parameter)
+{
+	if (LZMADecode(Input, InputSize, Output, OutputSize) < 0)
+		return -1;
+	return 0;
+}
+
+static int
+LZMACodecDecodeAlloc(unsigned char *Input, int InputSize,
+		     unsigned char **Output, int *OutputSize, int MaxSize,
+		     int Parameter)
+{
+	return LZMADecodeAlloc(Input, InputSize, Output, OutputSize, MaxSize);
+}
+
+static int DellSize(unsigned char *Input, int InputSize, int Parameter)
+{
+	return DellDecode(Input, InputSize, NULL, 0);
+}
+
+static int
+DellCodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+		int OutputSize, int Parameter)
+{
+	if (DellDecode(Input, InputSize, Output, OutputSize) != OutputSize)
+		return -1;
+	return 0;
+}
+
+static int
+HPCodecDecode(unsigned char *Input, int InputSize, unsigned char *Output,
+	      int OutputSize, int Parameter)
+{
+	return HPDecode(Input, InputSize, Output, OutputSize);
+}
+
+/* indexed by id */
+static struct Codec Codecs[CODEC_COUNT] = {
+	{CODEC_STORED, "stored", 0, StoredSize, StoredDecode, NULL},
+	{CODEC_LH5, "lh5", CODEC_NEEDS_OUTPUT_SIZE, NULL, LH5CodecDecode, NULL},
+	{CODEC_LZSS, "lzss", 0, LZSSSize, LZSSCodecDecode, NULL},
+	{CODEC_LZARI, "lzari", CODEC_NEEDS_OUTPUT_SIZE, NULL, LZARICodecDecode,
+	 NULL},
+	{CODEC_LZINT, "lzint", 0, EFISize, LZINTCodecDecode, NULL},
+	{CODEC_EFI, "efi", 0, EFISize, EFICodecDecode, NULL},
+	{CODEC_LZMA, "lzma", 0, LZMASize, LZMACodecDecode,
+	 LZMACodecDecodeAlloc},
+	{CODEC_DELL, "dell", 0, DellSize, DellCodecDecode, NULL},
+	{CODEC_HP, "hp", CODEC_NEEDS_OUTPUT_SIZE, NULL, HPCodecDecode, NULL},
+	{CODEC_LH6, "lh6", CODEC_NEEDS_OUTPUT_SIZE, NULL, LH6CodecDecode, NULL},
+	{CODEC_LH7, "lh7", CODEC_NEEDS_OUTPUT_SIZE, NULL, LH7CodecDecode, NULL},
+};
+
+struct Codec *CodecGet(int Id)
+{
+	if ((Id < 0) || (Id >= CODEC_COUNT))
+		return NULL;
+	return &Codecs[Id];
+}
+
+struct Codec *CodecFind(char *Name)
+{
+	int i;
+
+	for (i = 0; i < CODEC_COUNT; i++)
+		if (!strcmp(Codecs[i].Name, Name))
+			return &Codecs[i];
+	return NULL;
+}
+
+char *CodecName(int Id)
+{
+	struct Codec *Codec = CodecGet(Id);
+
+	return Codec ? Codec->Name : "unknown";
+}
+
+/*
+ * The expanded size as told by the stream itself, or -1.
+ */
+int CodecSize(int Id, unsigned char *Input, int InputSize, int Parameter)
+{
+	struct Codec *Codec = CodecGet(Id);
+
+	if (!Codec || (Codec->Flags & CODEC_NEEDS_OUTPUT_SIZE))
+		return -1;
+	return Codec->Size(Input, InputSize, Parameter);
+}
+
+int
+CodecDecode(int Id, unsigned char *Input, int InputSize, unsigned char *Output,
+	    int OutputSize, int Parameter)
+{
+	struct Codec *Codec = CodecGet(Id);
+
+	if (!Codec)
+		return -1;
+	return Codec->Decode(Input, InputSize, Output, OutputSize, Parameter);
+}
+
+/*
+ * Decode into a buffer of our own, of OutputSize bytes, or with a negative
+ * OutputSize, of the size the stream tells, which may not be more than
+ * MaxSize. Returns the number of input bytes used, which is all of them
+ * unless the codec can tell, or -1.
+ */
+int
+CodecDecodeAlloc(int Id, unsigned char *Input, int InputSize,
+		 unsigned char **Output, int *OutputSize, int MaxSize,
+		 int Parameter)
+{
+	struct Codec *Codec = CodecGet(Id);
+	unsigned char *Buffer;
+	int Size = *OutputSize, ret;
+
+	if (!Codec)
+		return -1;
+
+	/* decoding tells the size, so the stream gets decoded only once */
+	if (Codec->DecodeAlloc) {
+		ret = Codec->DecodeAlloc(Input, InputSize, &Buffer, OutputSize,
+					 MaxSize, Parameter);
+		if (ret < 0)
+			return -1;
+		if ((Size >= 0) && (*OutputSize != Size)) {
+			free(Buffer);
+			return -1;
+		}
+		*Output = Buffer;
+		return ret;
+	}
+
+	if (Size < 0) {
+		if (!(Codec->Flags & CODEC_NEEDS_OUTPUT_SIZE))
+			Size = Codec->Size(Input, InputSize, Parameter);
+		if (Size < 0) {
+			fprintf(stderr, "Error: %s stream does not tell its "
+				"size\n", Codec->Name);
+			return -1;
+		}
+	}
+	if (Size > MaxSize)
+		return -1;
+
+	Buffer = malloc(Size ? Size : 1);
+	if (!Buffer) {
+		fprintf(stderr, "Error: Failed to allocate %d bytes\n", Size);
+		return -1;
+	}
+
+	if (Codec->Decode(Input, InputSize, Buffer, Size, Parameter)) {
+		free(Buffer);
+		return -1;
+	}
+
+	*Output = Buffer;
+	*OutputSize = Size;
+	return InputSize;
+}
+
+/*
+ * Decode into a buffer of our own and pass that on. With a negative
+ * OutputSize, the size is taken from the stream.
+ */
+int
+CodecDecodeSink(int Id, unsigned char *Input, int InputSize, int OutputSize,
+		int Parameter, CodecSink Sink, void *Private)
+{
+	unsigned char *Buffer;
+	int ret = 0;
+
+	if (CodecDecodeAlloc(Id, Input, InputSize, &Buffer, &OutputSize,
+			     CODEC_SIZE_MAX, Parameter) < 0)
+		return -1;
+
+	if (!Sink(Private, Buffer, OutputSize))
+		ret = -1;
+
+	free(Buffer);
+	return ret;
+}
@@ -0,0 +1,88 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+enum CodecId {
+	CODEC_STORED = 0,
+	CODEC_LH5,
+	CODEC_LZSS,
+	CODEC_LZARI,
+	CODEC_LZINT,
+	CODEC_EFI,
+	CODEC_LZMA,
+	CODEC_DELL,
+	CODEC_HP,
+	CODEC_LH6,
+	CODEC_LH7,
+	CODEC_COUNT
+};
+
+#define CODEC_NEEDS_OUTPUT_SIZE	0x01	/* the stream does not tell its size */
+
+/* largest module we are willing to believe in */
+#define CODEC_SIZE_MAX 0x10000000
+
+/*
+ * Codec specific: the window fill for LZSS, the format version for EFI.
+ */
+#define CODEC_PARAMETER_DEFAULT	-1
+
+/*
+ * Decoders keep no state outside of their own stack frame, carving and the
+ * UEFI handler run them on any number of threads at once.
+ */
+struct Codec {
+	int Id;
+	char *Name;
+	unsigned int Flags;
+
+	/* expanded size, or -1. NULL with CODEC_NEEDS_OUTPUT_SIZE */
+	int (*Size) (unsigned char *Input, int InputSize, int Parameter);
+
+	/* fills in exactly OutputSize bytes, returns 0 or -1 */
+	int (*Decode) (unsigned char *Input, int InputSize,
+		       unsigned char *Output, int OutputSize, int Parameter);
+
+	/*
+	 * Optional, for streams which end with an end marker: decodes into a
+	 * buffer of its own, of at most MaxSize bytes, and returns the number
+	 * of input bytes used, or -1.
+	 */
+	int (*DecodeAlloc) (unsigned char *Input, int InputSize,
+			    unsigned char **Output, int *OutputSize,
+			    int MaxSize, int Parameter);
+};
+
+/* takes a whole expanded buffer, returns FALSE on failure */
+typedef Bool(*CodecSink) (void *Private, unsigned char *Buffer, int Size);
+
+struct Codec *CodecGet(int Id);
+struct Codec *CodecFind(char *Name);
+char *CodecName(int Id);
+
+int CodecSize(int Id, unsigned char *Input, int InputSize, int Parameter);
+int CodecDecode(int Id, unsigned char *Input, int InputSize,
+		unsigned char *Output, int OutputSize, int Parameter);
+int CodecDecodeAlloc(int Id, unsigned char *Input, int InputSize,
+		     unsigned char **Output, int *OutputSize, int MaxSize,
+		     int Parameter);
+int CodecDecodeSink(int Id, unsigned char *Input, int InputSize,
+		    int OutputSize, int Parameter, CodecSink Sink,
+		    void *Private);
+
+#endif				/* CODEC_H */
@@ -0,0 +1,190 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Dell/Phoenix "ROM BIOS PLUS" images: an optional chunk of EC code,
+ * followed by a chain of modules, each with a type byte and a 16 or 32bit
+ * length. All modules but the microcode updates are compressed, see
+ * dell_extract.c. Based on dell_inspiron_1100_unpacker.py by roxfan.
+ */
+
+#define _GNU_SOURCE 1		/* for memmem */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+
+/* the start of the first module, the main ROM */
+static const unsigned char DellSignature[] =
+    "\xF0\x00" "Copyright 1985-\x02\x04\xF0\x0F"
+    "8 Phoenix Technologies Ltd.";
+
+#define DELL_TYPE_MICROCODE	0x0C
+#define DELL_TYPE_END		0xFF
+
+/*
+ * Returns the offset of the module chain, and the size of the module
+ * headers, which tells the width of the length field.
+ */
+static int DellChainFind(unsigned char *BIOSImage, int BIOSLength,
+			 int *HeaderSize)
+{
+	unsigned char *p;
+	int Offset;
+
+	p = memmem(BIOSImage, BIOSLength, DellSignature,
+		   sizeof(DellSignature) - 1);
+	if (!p)
+		return -1;
+	Offset = p - BIOSImage;
+
+	if ((Offset >= 5) && (BIOSImage[Offset - 5] == 0x01)) {
+		*HeaderSize = 5;	/* 32bit length */
+		return Offset - 5;
+	}
+
+	if ((Offset >= 3) && (BIOSImage[Offset - 3] == 0x01)) {
+		*HeaderSize = 3;	/* 16bit length, e.g. the Inspiron 1100 */
+		return Offset - 3;
+	}
+
+	return -1;
+}
+
+Bool DellProbe(unsigned char *BIOSImage, int BIOSLength)
+{
+	int HeaderSize;
+
+	return DellChainFind(BIOSImage, BIOSLength, &HeaderSize) != -1;
+}
+
+static char *DellModuleNameGet(uint8_t Type)
+{
+	switch (Type) {
+	case 0x01:
+		return "Main ROM";
+	case DELL_TYPE_MICROCODE:
+		return "Microcode update";
+	default:
+		return NULL;
+	}
+}
+
+Bool
+DellExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
+	    uint32_t Offset1, uint32_t Offset2)
+{
+	struct ModuleInfo Info;
+	unsigned char *Buffer;
+	char filename[16];
+	int Offset, HeaderSize, Size;
+	uint32_t Length;
+	uint8_t Type;
+
+	Offset = DellChainFind(BIOSImage, BIOSLength, &HeaderSize);
+	if (Offset == -1)
+		return FALSE;
+
+	printf("Found Dell/Phoenix ROM BIOS PLUS image.\n");
+
+	if (Offset) {
+		printf("0x%05X (%6d bytes)   ->   EC.bin\n", 0, Offset);
+
+		Info.Offset = 0;
+		Info.PackedSize = Offset;
+		Info.ExpandedSize = Offset;
+		Info.Id = -1;
+		Info.Type = "dell";
+		Info.Codec = CodecName(CODEC_STORED);
+		Info.Name = "EC code";
+		Info.Guid = NULL;
+		Info.File = "EC.bin";
+		if (ModuleWanted(&Info))
+			WriteOutputFile("EC.bin", BIOSImage, Offset);
+	}
+
+	while ((Offset + HeaderSize) <= BIOSLength) {
+		Type = BIOSImage[Offset];
+		if (Type == DELL_TYPE_END)
+			return TRUE;
+
+		if (HeaderSize == 5)
+			Length = le32toh(*(uint32_t *) (BIOSImage + Offset + 1));
+		else
+			Length = le16toh(*(uint16_t *) (BIOSImage + Offset + 1));
+		Offset += HeaderSize;
+
+		if (Length > (BIOSLength - Offset)) {
+			fprintf(stderr, "Error: Module 0x%02X at 0x%05X overruns "
+				"the image\n", Type, Offset - HeaderSize);
+			return FALSE;
+		}
+
+		if (Type == DELL_TYPE_MICROCODE)
+			Size = Length;
+		else
+			Size = CodecSize(CODEC_DELL, BIOSImage + Offset, Length,
+					 CODEC_PARAMETER_DEFAULT);
+		if (Size < 0) {
+			fprintf(stderr, "Error: Invalid data in module 0x%02X at "
+				"0x%05X\n", Type, Offset - HeaderSize);
+			return FALSE;
+		}
+
+		sprintf(filename, "mod_%02X.bin", Type);
+		printf("0x%05X (%6d bytes)   ->   %s\t(%d bytes)", Offset,
+		       Length, filename, Size);
+		if (DellModuleNameGet(Type))
+			printf(" (%s)", DellModuleNameGet(Type));
+		printf("\n");
+
+		Info.Offset = Offset;
+		Info.PackedSize = Length;
+		Info.ExpandedSize = Size;
+		Info.Id = Type;
+		Info.Type = "dell";
+		Info.Codec = CodecName((Type == DELL_TYPE_MICROCODE) ?
+				       CODEC_STORED : CODEC_DELL);
+		Info.Name = DellModuleNameGet(Type);
+		Info.Guid = NULL;
+		Info.File = filename;
+
+		if (!ModuleWanted(&Info)) {
+			Offset += Length;
+			continue;
+		}
+
+		if (Type == DELL_TYPE_MICROCODE)
+			WriteOutputFile(filename, BIOSImage + Offset, Length);
+		else if (Size) {
+			Buffer = MMapOutputFile(filename, Size);
+			if (!Buffer)
+				return FALSE;
+			CodecDecode(CODEC_DELL, BIOSImage + Offset, Length, Buffer,
+				    Size, CODEC_PARAMETER_DEFAULT);
+			CloseOutputFile(Buffer, Size);
+		}
+
+		Offset += Length;
+	}
+
+	fprintf(stderr, "Error: Module chain runs past the end of the image\n");
+	return FALSE;
+}
@@ -0,0 +1,117 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * The nibble coded LZ variant of Dell/Phoenix ROM BIOS PLUS images. Based
+ * on dell_inspiron_1100_unpacker.py by roxfan.
+ */
+
+#include <string.h>
+
+#include "dell_extract.h"
+
+/*
+ * Low nibble 0: a literal run or a run of the previous byte. Otherwise a
+ * match, with a short or a long form. With a NULL OutputBuffer, only the
+ * size gets calculated. Returns the number of bytes produced, or -1.
+ */
+int
+DellDecode(unsigned char *Input, int InputSize, unsigned char *OutputBuffer,
+	   int OutputBufferSize)
+{
+	int i = 0, Offset = 0, Count, Distance, Low, High;
+
+	while (i < InputSize) {
+		Low = Input[i] & 0x0F;
+		High = Input[i] >> 4;
+		i++;
+
+		if (Low) {
+			if (Low == 0x0F) {
+				if ((i + 2) > InputSize)
+					return -1;
+				Count = ((High | (Input[i + 1] << 4)) & 0x3F) + 2;
+				Distance = ((Input[i + 1] >> 2) << 8) | Input[i];
+				i += 2;
+			} else {
+				if (i >= InputSize)
+					return -1;
+				Count = Low + 1;
+				Distance = (High << 8) | Input[i];
+				i++;
+			}
+			Distance++;
+
+			if ((Distance > Offset) ||
+			    (OutputBuffer && (Count > (OutputBufferSize - Offset))))
+				return -1;
+
+			if (!OutputBuffer)
+				;
+			else if (Distance >= Count)
+				memcpy(OutputBuffer + Offset,
+				       OutputBuffer + Offset - Distance, Count);
+			else if (Distance == 1)
+				memset(OutputBuffer + Offset,
+				       OutputBuffer[Offset - 1], Count);
+			else {
+				int k;
+
+				for (k = 0; k < Count; k++)
+					OutputBuffer[Offset + k] =
+					    OutputBuffer[Offset - Distance + k];
+			}
+			Offset += Count;
+		} else if (High == 0x0E) {
+			/* repeat the previous byte */
+			if ((i >= InputSize) || !Offset)
+				return -1;
+			Count = Input[i] + 1;
+			i++;
+
+			if (OutputBuffer) {
+				if (Count > (OutputBufferSize - Offset))
+					return -1;
+				memset(OutputBuffer + Offset,
+				       OutputBuffer[Offset - 1], Count);
+			}
+			Offset += Count;
+		} else {
+			/* literals */
+			if (High == 0x0F) {
+				if (i >= InputSize)
+					return -1;
+				Count = Input[i] + 15;
+				i++;
+			} else
+				Count = High + 1;
+
+			if (Count > (InputSize - i))
+				return -1;
+
+			if (OutputBuffer) {
+				if (Count > (OutputBufferSize - Offset))
+					return -1;
+				memcpy(OutputBuffer + Offset, Input + i, Count);
+			}
+			Offset += Count;
+			i += Count;
+		}
+	}
+
+	return Offset;
+}
@@ -0,0 +1,147 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Intel flash descriptors. Full SPI flash dumps hold the descriptor, the
+ * BIOS and the ME, GbE and other regions, only the BIOS region is mapped
+ * below 4GB and is what the handlers know about. The other regions are
+ * stored as they are.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+
+#define DESCRIPTOR_SIGNATURE	0x0FF0A55A
+#define DESCRIPTOR_SIZE		0x1000
+
+#define DESCRIPTOR_REGION_DESCRIPTOR	0
+#define DESCRIPTOR_REGION_BIOS		1
+
+static char *DescriptorRegionNames[] = {
+	"descriptor", "bios", "me", "gbe", "pdr", "devexp", "bios2",
+	"microcode", "ec", "devexp2", "ie", "10gbe1", "10gbe2", NULL, NULL,
+	"ptt"
+};
+
+#define DESCRIPTOR_REGIONS	16
+
+/*
+ * The signature is at 0x10, or at the very start with the earliest
+ * chipsets. Returns the offset of the signature, or -1.
+ */
+static int DescriptorFind(unsigned char *Image, int Length)
+{
+	if (Length < (2 * DESCRIPTOR_SIZE))
+		return -1;
+	if (le32toh(*(uint32_t *) (Image + 0x10)) == DESCRIPTOR_SIGNATURE)
+		return 0x10;
+	if (le32toh(*(uint32_t *) Image) == DESCRIPTOR_SIGNATURE)
+		return 0;
+	return -1;
+}
+
+static void
+DescriptorRegionStore(unsigned char *Image, int Region, uint32_t Base,
+		      uint32_t Length)
+{
+	struct ModuleInfo Info;
+	char filename[32], *Name = DescriptorRegionNames[Region];
+
+	if (Name)
+		snprintf(filename, sizeof(filename), "region_%s.bin", Name);
+	else
+		snprintf(filename, sizeof(filename), "region_%d.bin", Region);
+
+	printf("\t%-10s (%08X-%08X)    ->    %s\n", Name ? Name : "unknown",
+	       Base, Base + Length - 1, filename);
+
+	Info.Offset = Base;
+	Info.PackedSize = Length;
+	Info.ExpandedSize = Length;
+	Info.Id = Region;
+	Info.Type = "region";
+	Info.Codec = CodecName(CODEC_STORED);
+	Info.Name = Name;
+	Info.Guid = NULL;
+	Info.File = filename;
+
+	if (ModuleWanted(&Info))
+		WriteOutputFile(filename, Image + Base, Length);
+}
+
+/*
+ * When Image is a full flash dump, store all regions but the BIOS one,
+ * and return the offset of the BIOS region, with its length in
+ * *BIOSLength. Returns 0 otherwise.
+ */
+int DescriptorBIOSRegion(unsigned char *Image, int Length, int *BIOSLength)
+{
+	uint32_t Map, RegionBase, Region, Base, Limit;
+	int Signature, i, BIOSBase = 0;
+
+	Signature = DescriptorFind(Image, Length);
+	if (Signature < 0)
+		return 0;
+
+	/* FLMAP0 holds the region section base, in units of 16 bytes */
+	Map = le32toh(*(uint32_t *) (Image + Signature + 4));
+	RegionBase = ((Map >> 16) & 0xFF) << 4;
+	if ((RegionBase + 4 * DESCRIPTOR_REGIONS) > DESCRIPTOR_SIZE)
+		return 0;
+
+	Region = le32toh(*(uint32_t *) (Image + RegionBase +
+					4 * DESCRIPTOR_REGION_BIOS));
+	Base = (Region & 0x7FFF) << 12;
+	Limit = (((Region >> 16) & 0x7FFF) << 12) | 0xFFF;
+	if (!Region || (Base > Limit) || (Limit >= Length)) {
+		fprintf(stderr, "Warning: Intel flash descriptor without a "
+			"valid BIOS region, ignored.\n");
+		return 0;
+	}
+
+	printf("Intel flash descriptor, regions:\n");
+
+	for (i = 0; i < DESCRIPTOR_REGIONS; i++) {
+		Region = le32toh(*(uint32_t *) (Image + RegionBase + 4 * i));
+		Base = (Region & 0x7FFF) << 12;
+		Limit = (((Region >> 16) & 0x7FFF) << 12) | 0xFFF;
+
+		/*
+		 * Unused regions have their base above their limit, or are
+		 * left at 0, which would be a 4kB region at the very start
+		 * that only the descriptor itself can claim.
+		 */
+		if ((Base > Limit) || (Limit >= Length) ||
+		    (!Region && (i != DESCRIPTOR_REGION_DESCRIPTOR)))
+			continue;
+
+		if (i == DESCRIPTOR_REGION_BIOS) {
+			printf("\t%-10s (%08X-%08X)\n", "bios", Base, Limit);
+			BIOSBase = Base;
+			*BIOSLength = Limit + 1 - Base;
+			continue;
+		}
+
+		DescriptorRegionStore(Image, i, Base, Limit + 1 - Base);
+	}
+
+	return BIOSBase;
+}
@@ -0,0 +1,103 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * EFI 1.1 and Tiano decompression, through the LZH decoder in lh5_extract.c.
+ * The data starts with an 8 byte header holding the packed and the original
+ * size, followed by a LH5-like bitstream.
+ *
+ * Phoenix calls EFI 1.1 compression LZINT, and uses it for the compressed
+ * sections of SecureCore images.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "lh5_extract.h"
+#include "efi_extract.h"
+
+/*
+ * Returns the size of the header, or 0 when Buffer does not hold a valid
+ * one.
+ */
+int EFIHeaderParse(unsigned char *Buffer, int BufferSize,
+		   unsigned int *original_size, unsigned int *packed_size)
+{
+	if (BufferSize < 8)
+		return 0;
+
+	*packed_size = Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) |
+	    (Buffer[3] << 24);
+	*original_size = Buffer[4] | (Buffer[5] << 8) | (Buffer[6] << 16) |
+	    (Buffer[7] << 24);
+
+	if (*packed_size > (BufferSize - 8))
+		return 0;
+
+	return 8;
+}
+
+int
+EFIDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	  unsigned char *OutputBuffer, int OutputBufferSize, int Version)
+{
+	unsigned int original_size, packed_size;
+	int Method;
+
+	if (!EFIHeaderParse(PackedBuffer, PackedBufferSize, &original_size,
+			    &packed_size))
+		return -1;
+
+	if (original_size != OutputBufferSize)
+		return -1;
+
+	if (!original_size)
+		return 0;
+
+	if (Version == EFI_COMPRESSION_DETECT)
+		return LZHEFIDecode(PackedBuffer + 8, packed_size, OutputBuffer,
+				    OutputBufferSize);
+	else if (Version == EFI_COMPRESSION_TIANO)
+		Method = LZH_METHOD_TIANO;
+	else
+		Method = LZH_METHOD_LH5;
+
+	return LZHDecode(PackedBuffer + 8, packed_size, OutputBuffer,
+			 OutputBufferSize, Method);
+}
+
+/*
+ * Phoenix LZINT: the 8 byte EFI header followed by an EFI 1.1 bitstream,
+ * which is LH5 with its 8kB window. Tiano streams never show up here, so
+ * there is no point in guessing the version.
+ */
+int
+LZINTDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	    unsigned char *OutputBuffer, int OutputBufferSize)
+{
+	unsigned int original_size, packed_size;
+
+	if (!EFIHeaderParse(PackedBuffer, PackedBufferSize, &original_size,
+			    &packed_size))
+		return -1;
+
+	if (original_size != OutputBufferSize)
+		return -1;
+
+	return EFIDecode(PackedBuffer, packed_size + 8, OutputBuffer,
+			 OutputBufferSize, EFI_COMPRESSION_EFI);
+}
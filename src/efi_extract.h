@@ -0,0 +1,34 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef EFI_EXTRACT_H
+#define EFI_EXTRACT_H
+
+/* Versions of the EFI compression format */
+#define EFI_COMPRESSION_DETECT	0	/* tell from the stream itself */
+#define EFI_COMPRESSION_EFI	1	/* EFI 1.1, 4 bit position set size */
+#define EFI_COMPRESSION_TIANO	2	/* Tiano, 5 bit position set size */
+
+int EFIHeaderParse(unsigned char *Buffer, int BufferSize,
+		   unsigned int *original_size, unsigned int *packed_size);
+
+int EFIDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	      unsigned char *OutputBuffer, int OutputBufferSize, int Version);
+
+int LZINTDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+		unsigned char *OutputBuffer, int OutputBufferSize);
+
+#endif				/* EFI_EXTRACT_H */
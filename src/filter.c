@@ -0,0 +1,279 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Module selection. A filter is a comma separated list of terms, all of
+ * which have to match:
+ *
+ *   id=<n>[-<m>]	module id, or a range of ids
+ *   type=<glob>	module type, as written to the manifest
+ *   guid=<guid>	module GUID
+ *   name=<glob>	module name or output file name
+ *   size=[<min>]-[<max>] expanded size, k and M suffixes are allowed
+ *
+ * A module is extracted when it matches any of the --only filters (or when
+ * there are none), and none of the --exclude filters.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <strings.h>
+#include <fnmatch.h>
+
+#include "bios_extract.h"
+
+enum FilterTermType {
+	FILTER_ID,
+	FILTER_TYPE,
+	FILTER_GUID,
+	FILTER_NAME,
+	FILTER_SIZE,
+};
+
+struct FilterTerm {
+	enum FilterTermType Type;
+	char *Pattern;
+	uint32_t Min, Max;
+	struct FilterTerm *Next;
+};
+
+struct Filter {
+	struct FilterTerm *Terms;
+	struct Filter *Next;
+};
+
+static struct Filter *OnlyFilters;
+static struct Filter *ExcludeFilters;
+
+static Bool FilterNumberParse(char *String, char **End, uint32_t *Value)
+{
+	unsigned long long Number;
+
+	Number = strtoull(String, End, 0);
+	if (*End == String)
+		return FALSE;
+
+	if ((**End == 'k') || (**End == 'K')) {
+		Number <<= 10;
+		(*End)++;
+	} else if (**End == 'M') {
+		Number <<= 20;
+		(*End)++;
+	}
+
+	if (Number > 0xFFFFFFFF)
+		return FALSE;
+
+	*Value = Number;
+	return TRUE;
+}
+
+/*
+ * Parses "<n>", "<n>-<m>", "<n>-" and "-<m>".
+ */
+static Bool FilterRangeParse(char *String, uint32_t *Min, uint32_t *Max)
+{
+	char *End = String;
+
+	*Min = 0;
+	*Max = 0xFFFFFFFF;
+
+	if (*String != '-') {
+		if (!FilterNumberParse(String, &End, Min))
+			return FALSE;
+		if (!*End) {
+			*Max = *Min;
+			return TRUE;
+		}
+	}
+
+	if (*End != '-')
+		return FALSE;
+	End++;
+
+	if (!*End)
+		return TRUE;
+
+	if (!FilterNumberParse(End, &End, Max) || *End)
+		return FALSE;
+
+	return *Min <= *Max;
+}
+
+static struct FilterTerm *FilterTermParse(char *String)
+{
+	struct FilterTerm *Term;
+	char *Value;
+
+	Value = strchr(String, '=');
+	if (!Value)
+		return NULL;
+	*Value++ = '\0';
+
+	Term = calloc(1, sizeof(struct FilterTerm));
+	if (!Term)
+		return NULL;
+
+	if (!strcmp(String, "id"))
+		Term->Type = FILTER_ID;
+	else if (!strcmp(String, "type"))
+		Term->Type = FILTER_TYPE;
+	else if (!strcmp(String, "guid"))
+		Term->Type = FILTER_GUID;
+	else if (!strcmp(String, "name"))
+		Term->Type = FILTER_NAME;
+	else if (!strcmp(String, "size"))
+		Term->Type = FILTER_SIZE;
+	else {
+		free(Term);
+		return NULL;
+	}
+
+	if ((Term->Type == FILTER_ID) || (Term->Type == FILTER_SIZE)) {
+		uint32_t Min, Max;
+
+		if (!FilterRangeParse(Value, &Min, &Max)) {
+			free(Term);
+			return NULL;
+		}
+		Term->Min = Min;
+		Term->Max = Max;
+	} else
+		Term->Pattern = strdup(Value);
+
+	return Term;
+}
+
+Bool FilterAdd(char *Spec, Bool Exclude)
+{
+	struct Filter *Filter;
+	struct FilterTerm *Term;
+	char *String, *Token, *Save = NULL;
+
+	Filter = calloc(1, sizeof(struct Filter));
+	String = strdup(Spec);
+	if (!Filter || !String) {
+		fprintf(stderr, "Error: Out of memory for filter \"%s\"\n",
+			Spec);
+		return FALSE;
+	}
+
+	for (Token = strtok_r(String, ",", &Save); Token;
+	     Token = strtok_r(NULL, ",", &Save)) {
+		Term = FilterTermParse(Token);
+		if (!Term) {
+			fprintf(stderr, "Error: Invalid filter \"%s\"\n", Spec);
+			free(String);
+			return FALSE;
+		}
+		Term->Next = Filter->Terms;
+		Filter->Terms = Term;
+	}
+	free(String);
+
+	if (!Filter->Terms) {
+		fprintf(stderr, "Error: Empty filter\n");
+		return FALSE;
+	}
+
+	if (Exclude) {
+		Filter->Next = ExcludeFilters;
+		ExcludeFilters = Filter;
+	} else {
+		Filter->Next = OnlyFilters;
+		OnlyFilters = Filter;
+	}
+
+	return TRUE;
+}
+
+static Bool FilterGlobMatch(char *Pattern, char *String)
+{
+	if (!String)
+		return FALSE;
+	return !fnmatch(Pattern, String, FNM_CASEFOLD);
+}
+
+static Bool FilterTermMatch(struct FilterTerm *Term, struct ModuleInfo *Module)
+{
+	switch (Term->Type) {
+	case FILTER_ID:
+		return (Module->Id >= 0) && (Module->Id >= Term->Min) &&
+		    (Module->Id <= Term->Max);
+	case FILTER_TYPE:
+		return FilterGlobMatch(Term->Pattern, Module->Type);
+	case FILTER_GUID:
+		return Module->Guid && !strcasecmp(Term->Pattern, Module->Guid);
+	case FILTER_NAME:
+		return FilterGlobMatch(Term->Pattern, Module->Name) ||
+		    FilterGlobMatch(Term->Pattern, Module->File);
+	case FILTER_SIZE:
+		return (Module->ExpandedSize >= Term->Min) &&
+		    (Module->ExpandedSize <= Term->Max);
+	}
+
+	return FALSE;
+}
+
+static Bool FilterMatch(struct Filter *Filter, struct ModuleInfo *Module)
+{
+	struct FilterTerm *Term;
+
+	for (Term = Filter->Terms; Term; Term = Term->Next)
+		if (!FilterTermMatch(Term, Module))
+			return FALSE;
+	return TRUE;
+}
+
+/*
+ * Whether the filters select a module, without recording it anywhere.
+ */
+Bool ModuleSelected(struct ModuleInfo *Module)
+{
+	struct Filter *Filter;
+
+	for (Filter = ExcludeFilters; Filter; Filter = Filter->Next)
+		if (FilterMatch(Filter, Module))
+			return FALSE;
+
+	if (!OnlyFilters)
+		return TRUE;
+
+	for (Filter = OnlyFilters; Filter; Filter = Filter->Next)
+		if (FilterMatch(Filter, Module))
+			return TRUE;
+
+	return FALSE;
+}
+
+/*
+ * Called by the handlers for every module they find, before anything gets
+ * decoded. Records selected modules in the manifest, and tells whether
+ * the module should be extracted.
+ */
+Bool ModuleWanted(struct ModuleInfo *Module)
+{
+	if (!ModuleSelected(Module))
+		return FALSE;
+
+	ManifestModule(Module);
+
+	return !Options.List;
+}
@@ -0,0 +1,217 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Quick identification of BIOS images. Instead of mapping and scanning
+ * the whole image, only the regions which usually hold the identifying
+ * structures are read: the build date at F000:FFF5, the top 128kB with
+ * the AMIBIOSC header, the Phoenix BCPSYS block or the Award strings, and
+ * the start of the image. Only when none of those match, the whole image
+ * gets scanned.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "compat.h"
+#include "bios_extract.h"
+
+#define FINGERPRINT_TAIL_SIZE 0x20000
+#define FINGERPRINT_HEAD_SIZE 0x10000
+
+struct Fingerprint {
+	char *Vendor;
+	char Version[17];
+	char Date[9];
+};
+
+static int FingerprintRead(int fd, unsigned char *Buffer, int Size, off_t Offset)
+{
+	ssize_t ret;
+	int Done = 0;
+
+	while (Done < Size) {
+		ret = pread(fd, Buffer + Done, Size - Done, Offset + Done);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (!ret)
+			break;
+		Done += ret;
+	}
+
+	return Done;
+}
+
+/*
+ * Copy a printable string of at most Size bytes.
+ */
+static void
+FingerprintString(char *String, int Size, unsigned char *Buffer,
+		  unsigned char *End)
+{
+	int i;
+
+	for (i = 0; (i < Size) && (Buffer + i < End); i++) {
+		if (!isprint(Buffer[i]))
+			break;
+		String[i] = Buffer[i];
+	}
+	String[i] = '\0';
+
+	while (i && (String[i - 1] == ' '))
+		String[--i] = '\0';
+}
+
+/*
+ * mm/dd/yy, as found at F000:FFF5.
+ */
+static Bool FingerprintDate(char *Date)
+{
+	return isdigit(Date[0]) && isdigit(Date[1]) && (Date[2] == '/') &&
+	    isdigit(Date[3]) && isdigit(Date[4]) && (Date[5] == '/') &&
+	    isdigit(Date[6]) && isdigit(Date[7]);
+}
+
+static Bool
+FingerprintBuffer(unsigned char *Buffer, int Length, struct Fingerprint *Print)
+{
+	unsigned char *End = Buffer + Length, *p;
+
+	/* AMI95: version follows the AMIBIOSC signature */
+	p = memmem(Buffer, Length, "AMIBIOSC", 8);
+	while (p && (p + 12 <= End) && !memcmp(p + 8, "AMIN", 4))
+		p = memmem(p + 1, End - p - 1, "AMIBIOSC", 8);
+	if (p && (p + 12 <= End)) {
+		Print->Vendor = "AMI";
+		FingerprintString(Print->Version, 4, p + 8, End);
+		return TRUE;
+	}
+
+	/* Phoenix: version and date are in the BCPSYS block */
+	p = memmem(Buffer, Length, "BCPSYS", 6);
+	if (p && (p + 0x3F <= End)) {
+		Print->Vendor = "Phoenix";
+		FingerprintString(Print->Version, 8, p + 0x37, End);
+		if (!Print->Date[0])
+			FingerprintString(Print->Date, 8, p + 0x0F, End);
+		return TRUE;
+	}
+
+	p = memmem(Buffer, Length, "Award Modular BIOS ", 19);
+	if (p) {
+		Print->Vendor = "Award";
+		FingerprintString(Print->Version, 16, p + 19, End);
+		return TRUE;
+	}
+
+	if (memmem(Buffer, Length, "Award BootBlock", 15)) {
+		Print->Vendor = "Award";
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+Bool BIOSFingerprint(char *filename)
+{
+	struct Fingerprint Print;
+	unsigned char *Buffer;
+	off_t FileLength;
+	int fd, Size;
+	Bool Found;
+
+	memset(&Print, 0, sizeof(Print));
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Error: Failed to open %s: %s\n", filename,
+			strerror(errno));
+		return FALSE;
+	}
+
+	FileLength = lseek(fd, 0, SEEK_END);
+	if (FileLength < 16) {
+		fprintf(stderr, "Error: \"%s\" is too small for a BIOS image\n",
+			filename);
+		close(fd);
+		return FALSE;
+	}
+
+	Buffer = malloc(FINGERPRINT_TAIL_SIZE);
+	if (!Buffer) {
+		fprintf(stderr, "Error: Out of memory\n");
+		close(fd);
+		return FALSE;
+	}
+
+	/* the build date lives at F000:FFF5 on every PC BIOS */
+	if (FingerprintRead(fd, Buffer, 11, FileLength - 11) == 11) {
+		memcpy(Print.Date, Buffer, 8);
+		if (!FingerprintDate(Print.Date))
+			Print.Date[0] = '\0';
+	}
+
+	Size = FINGERPRINT_TAIL_SIZE;
+	if (Size > FileLength)
+		Size = FileLength;
+	Size = FingerprintRead(fd, Buffer, Size, FileLength - Size);
+	Found = (Size > 0) && FingerprintBuffer(Buffer, Size, &Print);
+
+	if (!Found && (FileLength > FINGERPRINT_TAIL_SIZE)) {
+		Size = FINGERPRINT_HEAD_SIZE;
+		Size = FingerprintRead(fd, Buffer, Size, 0);
+		Found = (Size > 0) && FingerprintBuffer(Buffer, Size, &Print);
+	}
+
+	free(Buffer);
+
+	/* inconclusive, fall back to scanning the whole image */
+	if (!Found) {
+		Buffer = mmap(NULL, FileLength, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (Buffer == ((void *)-1)) {
+			fprintf(stderr, "Error: Failed to mmap %s: %s\n",
+				filename, strerror(errno));
+			close(fd);
+			return FALSE;
+		}
+
+		if (!FingerprintBuffer(Buffer, FileLength, &Print))
+			Print.Vendor = BIOSVendorIdentify(Buffer, FileLength);
+
+		munmap(Buffer, FileLength);
+	}
+
+	close(fd);
+
+	printf("%s\t%s\t%s\t%s\n", filename,
+	       Print.Vendor ? Print.Vendor : "unknown",
+	       Print.Version[0] ? Print.Version : "-",
+	       Print.Date[0] ? Print.Date : "-");
+
+	return Print.Vendor != NULL;
+}
@@ -0,0 +1,211 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Firmware Interface Table. Intel images from Haswell on point to it from
+ * 4GB - 0x40, and it lists the microcode updates, the authenticated code
+ * modules and the Boot Guard manifests of the image. These are all stored,
+ * so they are written out as they are.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+
+struct FITEntry {
+	uint64_t Address;	/* "_FIT_   " in the header */
+	uint8_t Size[3];	/* in 16 byte units */
+	uint8_t Reserved;
+	uint16_t Version;	/* BCD major.minor */
+	uint8_t Type;		/* bit 7: the checksum is valid */
+	uint8_t Checksum;
+};
+
+#define FIT_POINTER		0x40	/* below 4GB */
+#define FIT_TYPE_HEADER		0x00
+#define FIT_TYPE_MICROCODE	0x01
+#define FIT_TYPE_STARTUP_ACM	0x02
+#define FIT_TYPE_SKIP		0x7F
+#define FIT_CHECKSUM_VALID	0x80
+
+static struct FITType {
+	uint8_t Id;
+	char *Name;
+} FITTypes[] = {
+	{0x01, "microcode"},
+	{0x02, "startup_acm"},
+	{0x03, "diagnostic_acm"},
+	{0x07, "bios_startup"},
+	{0x08, "tpm_policy"},
+	{0x09, "bios_policy"},
+	{0x0A, "txt_policy"},
+	{0x0B, "key_manifest"},
+	{0x0C, "boot_policy_manifest"},
+	{0x10, "cse_secure_boot"},
+	{0x2D, "txtsx_policy"},
+	{0x2F, "jmp_debug_policy"},
+	{0x00, NULL}
+};
+
+static char *FITTypeName(int Type)
+{
+	int i;
+
+	for (i = 0; FITTypes[i].Name; i++)
+		if (FITTypes[i].Id == Type)
+			return FITTypes[i].Name;
+	return "unknown";
+}
+
+/*
+ * Returns the offset in the image of a FIT address, which maps the end
+ * of the image to 4GB, or -1.
+ */
+static int FITOffset(uint64_t Address, int Length)
+{
+	uint64_t Base = 0x100000000ULL - Length;
+
+	if ((Address < Base) || (Address >= 0x100000000ULL))
+		return -1;
+	return Address - Base;
+}
+
+/*
+ * The size of what an entry points to. Microcode updates and ACMs carry it
+ * in their own headers, the FIT size field is often left at 0 for them.
+ */
+static uint32_t
+FITEntrySize(unsigned char *Image, int Length, int Offset, int Type,
+	     uint32_t Size)
+{
+	switch (Type) {
+	case FIT_TYPE_MICROCODE:
+		if ((Offset + 48) > Length)
+			return 0;
+		/* header version 1, and a data size of 0 means 2048 bytes */
+		if (le32toh(*(uint32_t *) (Image + Offset)) != 1)
+			return 0;
+		if (!le32toh(*(uint32_t *) (Image + Offset + 28)))
+			return 2048;
+		return le32toh(*(uint32_t *) (Image + Offset + 32));
+	case FIT_TYPE_STARTUP_ACM:
+		if ((Offset + 28) > Length)
+			return 0;
+		return le32toh(*(uint32_t *) (Image + Offset + 24)) * 4;
+	default:
+		return Size * 16;
+	}
+}
+
+/*
+ * Writes out the modules the FIT points to, when there is one. Returns
+ * FALSE when there is no valid FIT.
+ */
+Bool FITExtract(unsigned char *Image, int Length)
+{
+	struct FITEntry *Header, *Entry;
+	struct ModuleInfo Info;
+	uint64_t Pointer;
+	uint32_t Size, Entries;
+	char filename[48], Name[40];
+	unsigned char Sum = 0;
+	int Offset, Type, i;
+
+	if (Length < FIT_POINTER)
+		return FALSE;
+
+	memcpy(&Pointer, Image + Length - FIT_POINTER, 8);
+	Offset = FITOffset(le64toh(Pointer), Length);
+	if ((Offset < 0) || ((Offset + sizeof(struct FITEntry)) > Length))
+		return FALSE;
+
+	Header = (struct FITEntry *)(Image + Offset);
+	if (memcmp(Image + Offset, "_FIT_   ", 8) ||
+	    ((Header->Type & 0x7F) != FIT_TYPE_HEADER))
+		return FALSE;
+
+	Entries = Header->Size[0] | (Header->Size[1] << 8) |
+	    (Header->Size[2] << 16);
+	if (!Entries || ((Offset + Entries * sizeof(struct FITEntry)) > Length)) {
+		fprintf(stderr, "Error: Invalid FIT size %u\n", Entries);
+		return FALSE;
+	}
+
+	if (Header->Type & FIT_CHECKSUM_VALID) {
+		for (i = 0; i < (Entries * sizeof(struct FITEntry)); i++)
+			Sum += Image[Offset + i];
+		if (Sum)
+			fprintf(stderr, "Warning: Invalid FIT checksum\n");
+	}
+
+	printf("Firmware Interface Table at 0x%08X, %u entries\n", Offset,
+	       Entries - 1);
+
+	for (i = 1; i < Entries; i++) {
+		Entry = Header + i;
+		Type = Entry->Type & 0x7F;
+		if (Type == FIT_TYPE_SKIP)
+			continue;
+
+		Offset = FITOffset(le64toh(Entry->Address), Length);
+		Size = Entry->Size[0] | (Entry->Size[1] << 8) |
+		    (Entry->Size[2] << 16);
+
+		/* policies are stored in the entry itself, or in I/O space */
+		if (Offset < 0)
+			continue;
+		Size = FITEntrySize(Image, Length, Offset, Type, Size);
+		if (!Size || (Size > (Length - Offset))) {
+			fprintf(stderr, "Error: Invalid %s entry in the FIT\n",
+				FITTypeName(Type));
+			continue;
+		}
+
+		if (Type == FIT_TYPE_MICROCODE)
+			snprintf(Name, sizeof(Name), "cpu %08X rev %08X",
+				 le32toh(*(uint32_t *) (Image + Offset + 12)),
+				 le32toh(*(uint32_t *) (Image + Offset + 4)));
+		else
+			snprintf(Name, sizeof(Name), "version %X.%02X",
+				 le16toh(Entry->Version) >> 8,
+				 le16toh(Entry->Version) & 0xFF);
+
+		snprintf(filename, sizeof(filename), "fit_%02d_%s.bin", i,
+			 FITTypeName(Type));
+
+		printf("0x%08X (%7d bytes)    ->    %s  \t(%s)\n", Offset, Size,
+		       filename, Name);
+
+		Info.Offset = Offset;
+		Info.PackedSize = Size;
+		Info.ExpandedSize = Size;
+		Info.Id = Type;
+		Info.Type = FITTypeName(Type);
+		Info.Codec = CodecName(CODEC_STORED);
+		Info.Name = Name;
+		Info.Guid = NULL;
+		Info.File = filename;
+
+		if (ModuleWanted(&Info))
+			WriteOutputFile(filename, Image + Offset, Size);
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,185 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * HP Compaq 6715b/nc6320 images. From 0x10000 on, there is a chain of
+ * modules, each with a 16 byte header, a name padded to the header length
+ * and the optionally compressed data, see hp_extract.c. Based on
+ * hp_6715b_nc6320_unpacker.py by roxfan.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+
+#define HP_CHAIN_OFFSET 0x10000
+
+struct HPModuleHeader {
+	uint8_t Compression;	/* 0: stored, 1: LZSS, anything else ends */
+	uint8_t Unknown0;
+	uint8_t HeaderLength;	/* including the name */
+	uint8_t Unknown1;
+	uint32_t ExpandedLength;
+	uint32_t PackedLength;
+	uint32_t Destination;
+};
+
+#define HP_NAME_MAX 32
+
+/*
+ * Copies the module name, and returns FALSE when the header does not make
+ * sense.
+ */
+static Bool
+HPModuleHeaderCheck(unsigned char *BIOSImage, int BIOSLength, int Offset,
+		    char *Name)
+{
+	struct HPModuleHeader *Header =
+	    (struct HPModuleHeader *)(BIOSImage + Offset);
+	int i, Length;
+
+	if ((Offset + sizeof(struct HPModuleHeader)) > BIOSLength)
+		return FALSE;
+
+	if (Header->Compression > 1)
+		return FALSE;
+
+	Length = Header->HeaderLength - sizeof(struct HPModuleHeader);
+	if ((Length < 1) || (Length > HP_NAME_MAX))
+		return FALSE;
+	if ((Offset + Header->HeaderLength) > BIOSLength)
+		return FALSE;
+
+	for (i = 0; i < Length; i++) {
+		Name[i] = BIOSImage[Offset + sizeof(struct HPModuleHeader) + i];
+		if (!Name[i])
+			break;
+		if (!isprint(Name[i]))
+			return FALSE;
+	}
+	Name[i] = '\0';
+	if (!i)
+		return FALSE;
+
+	if (le32toh(Header->PackedLength) >
+	    (BIOSLength - Offset - Header->HeaderLength))
+		return FALSE;
+
+	if (!Header->Compression && (le32toh(Header->PackedLength) !=
+				     le32toh(Header->ExpandedLength)))
+		return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * The whole chain has to be sane, which holds up well as there is no
+ * signature to go by.
+ */
+Bool HPProbe(unsigned char *BIOSImage, int BIOSLength)
+{
+	struct HPModuleHeader *Header;
+	char Name[HP_NAME_MAX + 1];
+	int Offset = HP_CHAIN_OFFSET;
+
+	if (!HPModuleHeaderCheck(BIOSImage, BIOSLength, Offset, Name))
+		return FALSE;
+
+	while ((Offset < BIOSLength) && (BIOSImage[Offset] <= 1)) {
+		if (!HPModuleHeaderCheck(BIOSImage, BIOSLength, Offset, Name))
+			return FALSE;
+		Header = (struct HPModuleHeader *)(BIOSImage + Offset);
+		Offset += Header->HeaderLength + le32toh(Header->PackedLength);
+	}
+
+	return TRUE;
+}
+
+Bool
+HPExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
+	  uint32_t Offset1, uint32_t Offset2)
+{
+	struct HPModuleHeader *Header;
+	struct ModuleInfo Info;
+	char Name[HP_NAME_MAX + 1], filename[HP_NAME_MAX + 16];
+	unsigned char *Buffer, *Data;
+	uint32_t ExpandedLength, PackedLength;
+	int Offset = HP_CHAIN_OFFSET;
+
+	printf("Found HP 6715b/nc6320 image.\n");
+
+	while ((Offset < BIOSLength) && (BIOSImage[Offset] <= 1)) {
+		if (!HPModuleHeaderCheck(BIOSImage, BIOSLength, Offset, Name)) {
+			fprintf(stderr, "Error: Invalid module header at "
+				"0x%05X\n", Offset);
+			return FALSE;
+		}
+
+		Header = (struct HPModuleHeader *)(BIOSImage + Offset);
+		ExpandedLength = le32toh(Header->ExpandedLength);
+		PackedLength = le32toh(Header->PackedLength);
+		Data = BIOSImage + Offset + Header->HeaderLength;
+
+		snprintf(filename, sizeof(filename), "%04X_%s.bin",
+			 le32toh(Header->Destination) >> 4, Name);
+
+		printf("0x%05X (%6d bytes)   ->   %s\t(%d bytes)\n",
+		       (unsigned int)(Data - BIOSImage), PackedLength, filename,
+		       ExpandedLength);
+
+		Info.Offset = Data - BIOSImage;
+		Info.PackedSize = PackedLength;
+		Info.ExpandedSize = ExpandedLength;
+		Info.Id = -1;
+		Info.Type = "hp";
+		Info.Codec = CodecName(Header->Compression ? CODEC_HP :
+				       CODEC_STORED);
+		Info.Name = Name;
+		Info.Guid = NULL;
+		Info.File = filename;
+
+		Offset += Header->HeaderLength + PackedLength;
+
+		if (!ModuleWanted(&Info))
+			continue;
+
+		if (!Header->Compression) {
+			WriteOutputFile(filename, Data, PackedLength);
+			continue;
+		}
+
+		if (!ExpandedLength)
+			continue;
+
+		Buffer = MMapOutputFile(filename, ExpandedLength);
+		if (!Buffer)
+			return FALSE;
+
+		if (CodecDecode(CODEC_HP, Data, PackedLength, Buffer,
+				ExpandedLength, CODEC_PARAMETER_DEFAULT))
+			fprintf(stderr, "Error: Failed to decode %s\n",
+				filename);
+
+		CloseOutputFile(Buffer, ExpandedLength);
+	}
+
+	return TRUE;
+}
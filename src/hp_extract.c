@@ -0,0 +1,91 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * The LZSS variant of HP Compaq 6715b/nc6320 images: a flag byte per 8
+ * items, literals for set bits, 12bit distances and 4bit lengths. Based on
+ * hp_6715b_nc6320_unpacker.py by roxfan.
+ */
+
+#include <string.h>
+
+#include "hp_extract.h"
+
+/*
+ * Returns 0, or -1 when the data is broken.
+ */
+int
+HPDecode(unsigned char *Input, int InputSize, unsigned char *OutputBuffer,
+	 int OutputBufferSize)
+{
+	int i = 0, Offset = 0, Count, Distance, Item;
+	unsigned char Flags;
+
+	while (Offset < OutputBufferSize) {
+		if (i >= InputSize)
+			return -1;
+		Flags = Input[i++];
+
+		/* all literals, which is common enough to special case */
+		if (Flags == 0xFF) {
+			Count = 8;
+			if (Count > (OutputBufferSize - Offset))
+				Count = OutputBufferSize - Offset;
+			if (Count > (InputSize - i))
+				return -1;
+			memcpy(OutputBuffer + Offset, Input + i, Count);
+			Offset += Count;
+			i += Count;
+			continue;
+		}
+
+		for (Item = 0; (Item < 8) && (Offset < OutputBufferSize);
+		     Item++, Flags >>= 1) {
+			if (Flags & 0x01) {
+				if (i >= InputSize)
+					return -1;
+				OutputBuffer[Offset++] = Input[i++];
+				continue;
+			}
+
+			if ((i + 2) > InputSize)
+				return -1;
+			Count = (Input[i] & 0x0F) + 3;
+			Distance = (Input[i] | (Input[i + 1] << 8)) >> 4;
+			i += 2;
+
+			if (!Distance || (Distance > Offset))
+				return -1;
+			if (Count > (OutputBufferSize - Offset))
+				Count = OutputBufferSize - Offset;
+
+			if (Distance >= Count)
+				memcpy(OutputBuffer + Offset,
+				       OutputBuffer + Offset - Distance, Count);
+			else {
+				int k;
+
+				for (k = 0; k < Count; k++)
+					OutputBuffer[Offset + k] =
+					    OutputBuffer[Offset - Distance + k];
+			}
+			Offset += Count;
+		}
+	}
+
+	return 0;
+}
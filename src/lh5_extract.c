@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include "compat.h"
 #include "lh5_extract.h"
 
@@ -49,6 +50,31 @@ static int calc_sum(unsigned char *p, int len)
 }
 
 /*
+ * level 0 header
+ *
+ *
+ * offset   size  field name
+ * -----------------------------------
+ *     0       1  header size   [*1]
+ *     1       1  header sum
+ *             ---------------------------------------
+ *     2       5  method ID                         ^
+ *     7       4  packed size   [*2]                |
+ *    11       4  original size                     |
+ *    15       2  time                              |
+ *    17       2  date                              |
+ *    19       1  attribute                         | [*1] header size (X+Y+22)
+ *    20       1  level (0x00 fixed)                |
+ *    21       1  name length                       |
+ *    22       X  pathname                          |
+ * X +22       2  file crc (CRC-16)                 |
+ * X +24       Y  ext-header(old style)             v
+ * -------------------------------------------------
+ * X+Y+24         data                              ^
+ *                 :                                | [*2] packed size
+ *                 :                                v
+ * -------------------------------------------------
+ *
  * level 1 header
  *
  *
@@ -78,83 +104,229 @@ static int calc_sum(unsigned char *p, int len)
  *                 :                               v
  * -------------------------------------------------
  *
+ * level 2 header
+ *
+ *
+ * offset   size  field name
+ * --------------------------------------------------
+ *     0       2  total header size [*1]           ^
+ *             -----------------------             |
+ *     2       5  method ID                        |
+ *     7       4  packed size       [*2]           |
+ *    11       4  original size                    |
+ *    15       4  time                             |
+ *    19       1  RESERVED (0x20 fixed)            | [*1] total header size
+ *    20       1  level (0x02 fixed)               |      (X+26+(1))
+ *    21       2  file crc (CRC-16)                |
+ *    23       1  OS ID                            |
+ *    24       2  next-header size                 |
+ * -----------------------------------             |
+ *    26       X  ext-header                       |
+ *                 :                               |
+ * -----------------------------------             |
+ * X +26      (1) padding                          v
+ * -------------------------------------------------
+ * X +26+(1)      data                             ^
+ *                 :                               | [*2] packed size
+ *                 :                               v
+ * -------------------------------------------------
+ *
+ * An extended header is a type byte, its data and the size of the next
+ * extended header. Type 0x01 holds the filename.
  */
-unsigned int
-LH5HeaderParse(unsigned char *Buffer, int BufferSize,
-	       unsigned int *original_size, unsigned int *packed_size,
-	       char **name, unsigned short *crc)
+#define LHA_EXT_FILENAME	0x01
+
+/*
+ * Walks the extended headers from Offset on, which start with their size
+ * at Offset - 2. Returns the offset past the last one, or 0.
+ */
+static unsigned int
+LHAExtendedHeadersParse(unsigned char *Buffer, int BufferSize,
+			unsigned int Offset, char **name)
 {
-	unsigned int offset;
-	unsigned char header_size, checksum, name_length;
+	unsigned short extend_size;
 
-	if (BufferSize < 27) {
-		fprintf(stderr,
-			"Error: Packed Buffer is too small to contain an lha header.\n");
-		return 0;
+	while (1) {
+		extend_size = le16toh(*(unsigned short *)(Buffer + Offset - 2));
+		if (!extend_size)
+			return Offset;
+
+		if ((extend_size < 3) || ((Offset + extend_size) > BufferSize)) {
+			fprintf(stderr,
+				"Error: Buffer to small to contain extended header.\n");
+			return 0;
+		}
+
+		if (Buffer[Offset] == LHA_EXT_FILENAME) {
+			free(*name);
+			*name = strndup((char *)Buffer + Offset + 1,
+					extend_size - 3);
+		}
+
+		Offset += extend_size;
 	}
+}
 
-	/* check attribute */
-	if (Buffer[19] != 0x20) {
-		fprintf(stderr, "Error: Invalid lha header attribute byte.\n");
-		return 0;
+/*
+ * Returns the LZH_METHOD for a method ID, or -1.
+ */
+static int LHAMethodGet(unsigned char *ID)
+{
+	if (memcmp(ID, "-lh", 3) || (ID[4] != '-'))
+		return -1;
+
+	switch (ID[3]) {
+	case '0':
+		return LZH_METHOD_STORED;
+	case '5':
+		return LZH_METHOD_LH5;
+	case '6':
+		return LZH_METHOD_LH6;
+	case '7':
+		return LZH_METHOD_LH7;
+	default:
+		return -1;
 	}
+}
+
+/*
+ * A quick and silent test whether Buffer starts with an lha header, for
+ * when headers have to be searched for rather than walked. The level 0 and
+ * 1 checksum rejects nearly all chance matches of the method ID.
+ */
+int LHAHeaderCheck(unsigned char *Buffer, int BufferSize)
+{
+	unsigned int header_size;
 
-	/* check method */
-	if (memcmp(Buffer + 2, "-lh5-", 5) != 0) {
-		fprintf(stderr, "Error: Compression method is not LZHUFF5.\n");
+	if ((BufferSize < 24) || (LHAMethodGet(Buffer + 2) == -1))
 		return 0;
-	}
 
-	/* check header level */
-	if (Buffer[20] != 1) {
-		fprintf(stderr, "Error: Header level %d is not supported\n",
-			Buffer[20]);
+	switch (Buffer[20]) {
+	case 0:
+	case 1:
+		header_size = Buffer[0];
+		if ((header_size < 22) || ((header_size + 2) > BufferSize))
+			return 0;
+		if ((22 + Buffer[21]) > header_size)
+			return 0;
+		return calc_sum(Buffer + 2, header_size) == Buffer[1];
+	case 2:
+		header_size = le16toh(*(unsigned short *)Buffer);
+		return (header_size >= 26) && (header_size <= BufferSize);
+	default:
 		return 0;
 	}
+}
 
-	/* read in the full header */
-	header_size = Buffer[0];
-	if (BufferSize < (header_size + 2)) {
+/*
+ * Returns the size of the header, up to the packed data, or 0 when Buffer
+ * does not hold a valid one. *name has to be freed.
+ */
+unsigned int
+LHAHeaderParse(unsigned char *Buffer, int BufferSize,
+	       unsigned int *original_size, unsigned int *packed_size,
+	       char **name, unsigned short *crc, int *method)
+{
+	unsigned int offset, header_size;
+	unsigned char name_length;
+
+	if (BufferSize < 24) {
 		fprintf(stderr,
-			"Error: Packed Buffer is too small to contain the full header.\n");
+			"Error: Packed Buffer is too small to contain an lha header.\n");
 		return 0;
 	}
 
-	/* verify checksum */
-	checksum = Buffer[1];
-	if (calc_sum(Buffer + 2, header_size) != checksum) {
-		fprintf(stderr, "Error: Invalid lha header checksum.\n");
+	*method = LHAMethodGet(Buffer + 2);
+	if (*method == -1) {
+		fprintf(stderr, "Error: Compression method %.5s is not "
+			"supported.\n", Buffer + 2);
 		return 0;
 	}
 
 	*packed_size = le32toh(*(unsigned int *)(Buffer + 7));
 	*original_size = le32toh(*(unsigned int *)(Buffer + 11));
+	*name = NULL;
+
+	switch (Buffer[20]) {
+	case 0:
+	case 1:
+		/* read in the full header */
+		header_size = Buffer[0];
+		if (BufferSize < (header_size + 2)) {
+			fprintf(stderr,
+				"Error: Packed Buffer is too small to contain the full header.\n");
+			return 0;
+		}
 
-	name_length = Buffer[21];
-	*name = strndup((char *)Buffer + 22, name_length);
+		/* verify checksum */
+		if (calc_sum(Buffer + 2, header_size) != Buffer[1]) {
+			fprintf(stderr, "Error: Invalid lha header checksum.\n");
+			return 0;
+		}
 
-	*crc = le16toh(*(unsigned short *)(Buffer + 22 + name_length));
+		name_length = Buffer[21];
+		if ((22 + name_length + 2) > (header_size + 2)) {
+			fprintf(stderr, "Error: Invalid lha header name length.\n");
+			return 0;
+		}
 
-	offset = header_size + 2;
-	/* Skip extended headers */
-	while (1) {
-		unsigned short extend_size =
-		    le16toh(*(unsigned short *)(Buffer + offset - 2));
+		*name = strndup((char *)Buffer + 22, name_length);
+		*crc = le16toh(*(unsigned short *)(Buffer + 22 + name_length));
 
-		if (!extend_size)
+		offset = header_size + 2;
+		if (Buffer[20] == 0)
 			break;
 
-		*packed_size -= extend_size;
-		offset += extend_size;
+		/* the skip size includes the extended headers */
+		offset = LHAExtendedHeadersParse(Buffer, BufferSize, offset,
+						 name);
+		if (!offset)
+			goto error;
+
+		if ((offset - header_size - 2) > *packed_size) {
+			fprintf(stderr, "Error: Invalid lha skip size.\n");
+			goto error;
+		}
+		*packed_size -= offset - header_size - 2;
+		break;
 
-		if (BufferSize < offset) {
+	case 2:
+		header_size = le16toh(*(unsigned short *)Buffer);
+		if ((header_size < 26) || (BufferSize < header_size)) {
 			fprintf(stderr,
-				"Error: Buffer to small to contain extended header.\n");
+				"Error: Packed Buffer is too small to contain the full header.\n");
 			return 0;
 		}
+
+		*crc = le16toh(*(unsigned short *)(Buffer + 21));
+
+		offset = LHAExtendedHeadersParse(Buffer, header_size, 26, name);
+		if (!offset)
+			goto error;
+
+		/* the padding byte, if any, is counted in the header size */
+		offset = header_size;
+		break;
+
+	default:
+		fprintf(stderr, "Error: Header level %d is not supported\n",
+			Buffer[20]);
+		return 0;
 	}
 
+	if (*packed_size > (BufferSize - offset)) {
+		fprintf(stderr, "Error: Packed data runs past the buffer.\n");
+		goto error;
+	}
+
+	if (!*name)
+		*name = strdup("");
+
 	return offset;
+
+ error:
+	free(*name);
+	return 0;
 }
 
 /*
@@ -191,363 +363,638 @@ unsigned short CRC16Calculate(unsigned char *Buffer, int BufferSize)
 }
 
 /*
- * Bit handling code.
+ * LZH decoding: LZ77 with static Huffman coding, as used by LHA -lh5-,
+ * -lh6- and -lh7-, and by EFI 1.1 and Tiano compression. These only differ
+ * in their window size and in the width of the field holding the size of the
+ * position set. Each variant gets its own copy of the decoding loop, with
+ * both as constants, so that the hot path does not have to look them up.
+ *
+ * The decoder state lives on the stack of LZHDecode(), which makes this
+ * reentrant. EFI 1.1 streams are -lh5- streams, Tiano streams use -lh7-
+ * coding with a 512kB window.
  */
-static unsigned char *CompressedBuffer;
-static int CompressedSize;
-static int CompressedOffset;
-
-static unsigned short bitbuf;
-static unsigned char subbitbuf, bitcount;
+#define LZH_MAXMATCH	256	/* formerly F (not more than 255 + 1) */
+#define LZH_THRESHOLD	3	/* choose optimal value */
+#define LZH_NC		(255 + LZH_MAXMATCH + 2 - LZH_THRESHOLD)
+#define LZH_NT		(16 + 3)	/* USHORT + THRESHOLD */
+#define LZH_NPT		0x20	/* NT, or the largest position set */
+
+#define LZH_TBIT	5	/* smallest integer such that (1 << TBIT) > NT */
+#define LZH_CBIT	9	/* smallest integer such that (1 << CBIT) > NC */
+
+#define LZH_CTABLE_BITS		12
+#define LZH_PTTABLE_BITS	8
+
+struct LZHDecoder {
+	/* bit reader, the top BitCount bits of BitBuf are valid */
+	unsigned char *Input;
+	int InputSize;
+	int InputOffset;
+	int Padding;		/* zero bytes read past the end */
+	uint64_t BitBuf;
+	int BitCount;
+
+	/* codes left in the current block once decoding stops */
+	unsigned short BlockLeft;
+
+	/* tables, held outside the (packed) structure */
+	unsigned short *Left;
+	unsigned short *Right;
+	unsigned short *CTable;
+	unsigned short *PTTable;
+	unsigned char *CLen;
+	unsigned char *PTLen;
+};
 
-static void BitBufInit(unsigned char *Buffer, int BufferSize)
+/*
+ * Bit handling code. Past the end of the input, zeroes are read.
+ */
+static void LZHBitsFill(struct LZHDecoder *Decoder)
 {
-	CompressedBuffer = Buffer;
-	CompressedOffset = 0;
-	CompressedSize = BufferSize;
+	uint64_t Byte;
 
-	bitbuf = 0;
-	subbitbuf = 0;
-	bitcount = 0;
-}
-
-static void fillbuf(unsigned char n)
-{				/* Shift bitbuf n bits left, read n bits */
-	while (n > bitcount) {
-		n -= bitcount;
-		bitbuf = (bitbuf << bitcount) + (subbitbuf >> (8 - bitcount));
-
-		if (CompressedOffset < CompressedSize) {
-			subbitbuf = CompressedBuffer[CompressedOffset];
-			CompressedOffset++;
-		} else
-			subbitbuf = 0;
+	while (Decoder->BitCount <= 56) {
+		if (Decoder->InputOffset < Decoder->InputSize)
+			Byte = Decoder->Input[Decoder->InputOffset++];
+		else {
+			Byte = 0;
+			Decoder->Padding++;
+		}
 
-		bitcount = 8;
+		Decoder->BitBuf |= Byte << (56 - Decoder->BitCount);
+		Decoder->BitCount += 8;
 	}
-	bitcount -= n;
-	bitbuf = (bitbuf << n) + (subbitbuf >> (8 - n));
-	subbitbuf <<= n;
 }
 
-static unsigned short getbits(unsigned char n)
+static void
+LZHBitsInit(struct LZHDecoder *Decoder, unsigned char *Buffer, int BufferSize)
 {
-	unsigned short x;
-
-	x = bitbuf >> (16 - n);
-	fillbuf(n);
+	Decoder->Input = Buffer;
+	Decoder->InputSize = BufferSize;
+	Decoder->InputOffset = 0;
+	Decoder->Padding = 0;
+	Decoder->BitBuf = 0;
+	Decoder->BlockLeft = 0;
+	Decoder->BitCount = 0;
+
+	LZHBitsFill(Decoder);
+}
 
-	return x;
+/* Never more than 32 bits are peeked at or dropped at once. */
+static inline unsigned int LZHBitsPeek(struct LZHDecoder *Decoder, int n)
+{
+	return Decoder->BitBuf >> (64 - n);
 }
 
-static unsigned short peekbits(unsigned char n)
+static inline void LZHBitsDrop(struct LZHDecoder *Decoder, int n)
 {
-	unsigned short x;
+	Decoder->BitBuf <<= n;
+	Decoder->BitCount -= n;
+	if (Decoder->BitCount < 32)
+		LZHBitsFill(Decoder);
+}
 
-	x = bitbuf >> (16 - n);
+static inline unsigned int LZHBitsGet(struct LZHDecoder *Decoder, int n)
+{
+	unsigned int x = LZHBitsPeek(Decoder, n);
 
+	LZHBitsDrop(Decoder, n);
 	return x;
 }
 
 /*
- *
- * LHA extraction.
- *
+ * Whether decoding used up all of the input: the last block has to be
+ * complete, and encoders pad the last byte with less than 8 zero bits.
  */
-#define MIN(a,b) ((a) <= (b) ? (a) : (b))
-
-#define LZHUFF5_DICBIT		13	/* 2^13 =  8KB sliding dictionary */
-#define MAXMATCH			256	/* formerly F (not more than 255 + 1) */
-#define THRESHOLD			3	/* choose optimal value */
-#define NP					(LZHUFF5_DICBIT + 1)
-#define NT					(16 + 3)	/* USHORT + THRESHOLD */
-#define NC					(255 + MAXMATCH + 2 - THRESHOLD)
-
-#define PBIT 4			/* smallest integer such that (1 << PBIT) > * NP */
-#define TBIT 5			/* smallest integer such that (1 << TBIT) > * NT */
-#define CBIT 9			/* smallest integer such that (1 << CBIT) > * NC */
-
-/* #if NT > NP #define NPT NT #else #define NPT NP #endif  */
-#define NPT         0x80
-
-static unsigned short left[2 * NC - 1], right[2 * NC - 1];
-
-static unsigned short c_table[4096];	/* decode */
-static unsigned short pt_table[256];	/* decode */
+static int LZHBitsAllUsed(struct LZHDecoder *Decoder)
+{
+	int Left = Decoder->InputSize * 8 -
+	    ((Decoder->InputOffset + Decoder->Padding) * 8 -
+	     Decoder->BitCount);
 
-static unsigned char c_len[NC];
-static unsigned char pt_len[NPT];
+	if (Decoder->BlockLeft || (Left < 0) || (Left > 7))
+		return 0;
+	if (!Left)
+		return 1;
+	return !(Decoder->Input[Decoder->InputSize - 1] & ((1 << Left) - 1));
+}
 
+/*
+ * Creates the lookup table for the first TableBits bits of the codes, and a
+ * tree for the remaining bits of longer codes.
+ */
 static int
-make_table(short nchar, unsigned char bitlen[], short tablebits,
-	   unsigned short table[])
+LZHTableMake(struct LZHDecoder *Decoder, int nchar, unsigned char *bitlen,
+	     int tablebits, unsigned short *table)
 {
-	unsigned short count[17];	/* count of bitlen */
-	unsigned short weight[17];	/* 0x10000ul >> bitlen */
-	unsigned short start[17];	/* first code of bitlen */
-	unsigned short total;
-	unsigned int i, l;
-	int j, k, m, n, avail;
+	unsigned int count[17];	/* count of bitlen */
+	unsigned int weight[17];	/* 0x10000ul >> bitlen */
+	unsigned int start[18];	/* first code of bitlen */
+	unsigned int i, k, l, code;
 	unsigned short *p;
+	int j, n, avail;
 
-	avail = nchar;
-
-	/* initialize */
-	for (i = 1; i <= 16; i++) {
+	for (i = 1; i <= 16; i++)
 		count[i] = 0;
-		weight[i] = 1 << (16 - i);
-	}
 
-	/* count */
-	for (i = 0; i < nchar; i++) {
-		if (bitlen[i] > 16) {
-			/* CVE-2006-4335 */
-			fprintf(stderr, "Error: Bad table (case a)\n");
+	for (j = 0; j < nchar; j++) {
+		if (bitlen[j] > 16)
 			return -1;
-		} else
-			count[bitlen[i]]++;
+		count[bitlen[j]]++;
 	}
 
-	/* calculate first code */
-	total = 0;
-	for (i = 1; i <= 16; i++) {
-		start[i] = total;
-		total += weight[i] * count[i];
-	}
-	if (((total & 0xffff) != 0) || (tablebits > 16)) {	/* 16 for weight below */
-		fprintf(stderr, "Error: make_table(): Bad table (case b)\n");
+	start[1] = 0;
+	for (i = 1; i <= 16; i++)
+		start[i + 1] = start[i] + (count[i] << (16 - i));
+	if (start[17] != 0x10000)
 		return -1;
-	}
 
-	/* shift data for make table. */
-	m = 16 - tablebits;
 	for (i = 1; i <= tablebits; i++) {
-		start[i] >>= m;
-		weight[i] >>= m;
+		start[i] >>= 16 - tablebits;
+		weight[i] = 1 << (tablebits - i);
 	}
+	for (; i <= 16; i++)
+		weight[i] = 1 << (16 - i);
 
-	/* initialize */
-	j = start[tablebits + 1] >> m;
-	k = MIN(1 << tablebits, 4096);
-	if (j != 0)
-		for (i = j; i < k; i++)
-			table[i] = 0;
+	/* clear the entries which lead into the tree */
+	for (i = start[tablebits + 1] >> (16 - tablebits);
+	     i < (1 << tablebits); i++)
+		table[i] = 0;
 
-	/* create table and tree */
+	avail = nchar;
 	for (j = 0; j < nchar; j++) {
 		k = bitlen[j];
-		if (k == 0)
+		if (!k)
 			continue;
+
 		l = start[k] + weight[k];
 		if (k <= tablebits) {
-			/* code in table */
-			l = MIN(l, 4096);
 			for (i = start[k]; i < l; i++)
 				table[i] = j;
 		} else {
-			/* code not in table */
-			i = start[k];
-			if ((i >> m) > 4096) {
-				/* CVE-2006-4337 */
-				fprintf(stderr, "Error: Bad table (case c)");
-				exit(1);
-			}
-			p = &table[i >> m];
-			i <<= tablebits;
-			n = k - tablebits;
-			/* make tree (n length) */
-			while (--n >= 0) {
-				if (*p == 0) {
-					right[avail] = left[avail] = 0;
+			code = start[k];
+			p = table + (code >> (16 - tablebits));
+			code <<= tablebits;
+			for (n = k - tablebits; n; n--) {
+				if (!*p) {
+					if (avail >= (2 * LZH_NC - 1))
+						return -1;
+					Decoder->Right[avail] = 0;
+					Decoder->Left[avail] = 0;
 					*p = avail++;
 				}
-				if (i & 0x8000)
-					p = &right[*p];
+				if (code & 0x8000)
+					p = Decoder->Right + *p;
 				else
-					p = &left[*p];
-				i <<= 1;
+					p = Decoder->Left + *p;
+				code <<= 1;
 			}
 			*p = j;
 		}
 		start[k] = l;
 	}
+
 	return 0;
 }
 
-static int read_pt_len(short nn, short nbit, short i_special)
+/*
+ * Walks the tree for codes longer than the lookup table.
+ */
+static inline unsigned int
+LZHTreeWalk(struct LZHDecoder *Decoder, unsigned int j, int tablebits,
+	    unsigned int nchar)
+{
+	uint64_t mask = 1ULL << (63 - tablebits);
+
+	do {
+		if (Decoder->BitBuf & mask)
+			j = Decoder->Right[j];
+		else
+			j = Decoder->Left[j];
+		mask >>= 1;
+	} while (j >= nchar);
+
+	return j;
+}
+
+/*
+ * Reads the code lengths of the extra set, or of the position set.
+ */
+static int LZHPTLenRead(struct LZHDecoder *Decoder, int nn, int nbit,
+			int i_special)
 {
 	int i, c, n;
 
-	n = getbits(nbit);
-	if (n == 0) {
-		c = getbits(nbit);
+	n = LZHBitsGet(Decoder, nbit);
+	if (!n) {
+		c = LZHBitsGet(Decoder, nbit);
+		if (c >= nn)
+			return -1;
+
 		for (i = 0; i < nn; i++)
-			pt_len[i] = 0;
-		for (i = 0; i < 256; i++)
-			pt_table[i] = c;
-	} else {
-		i = 0;
-		while (i < MIN(n, NPT)) {
-			c = peekbits(3);
-			if (c != 7)
-				fillbuf(3);
-			else {
-				unsigned short mask = 1 << (16 - 4);
-				while (mask & bitbuf) {
-					mask >>= 1;
-					c++;
-				}
-				fillbuf(c - 3);
-			}
+			Decoder->PTLen[i] = 0;
+		for (i = 0; i < (1 << LZH_PTTABLE_BITS); i++)
+			Decoder->PTTable[i] = c;
+		return 0;
+	}
+
+	if (n > nn)
+		return -1;
 
-			pt_len[i++] = c;
-			if (i == i_special) {
-				c = getbits(2);
-				while (--c >= 0 && i < NPT)
-					pt_len[i++] = 0;
+	i = 0;
+	while (i < n) {
+		c = LZHBitsPeek(Decoder, 3);
+		if (c != 7)
+			LZHBitsDrop(Decoder, 3);
+		else {
+			uint64_t mask = 1ULL << (63 - 3);
+
+			while ((mask & Decoder->BitBuf) && (c < 32)) {
+				mask >>= 1;
+				c++;
 			}
+			LZHBitsDrop(Decoder, c - 3);
 		}
-		while (i < nn)
-			pt_len[i++] = 0;
 
-		if (make_table(nn, pt_len, 8, pt_table) == -1)
-			return -1;
+		Decoder->PTLen[i++] = c;
+		if (i == i_special) {
+			c = LZHBitsGet(Decoder, 2);
+			while ((--c >= 0) && (i < nn))
+				Decoder->PTLen[i++] = 0;
+		}
 	}
-	return 0;
+	while (i < nn)
+		Decoder->PTLen[i++] = 0;
+
+	return LZHTableMake(Decoder, nn, Decoder->PTLen, LZH_PTTABLE_BITS,
+			    Decoder->PTTable);
 }
 
-static int read_c_len(void)
+/*
+ * Reads the code lengths of the character and length set, which are coded
+ * with the extra set.
+ */
+static int LZHCLenRead(struct LZHDecoder *Decoder)
 {
-	short i, c, n;
-
-	n = getbits(CBIT);
-	if (n == 0) {
-		c = getbits(CBIT);
-		for (i = 0; i < NC; i++)
-			c_len[i] = 0;
-		for (i = 0; i < 4096; i++)
-			c_table[i] = c;
-	} else {
-		i = 0;
-		while (i < MIN(n, NC)) {
-			c = pt_table[peekbits(8)];
-			if (c >= NT) {
-				unsigned short mask = 1 << (16 - 9);
-				do {
-					if (bitbuf & mask)
-						c = right[c];
-					else
-						c = left[c];
-					mask >>= 1;
-				} while (c >= NT && (mask || c != left[c]));	/* CVE-2006-4338 */
-			}
-			fillbuf(pt_len[c]);
-			if (c <= 2) {
-				if (c == 0)
-					c = 1;
-				else if (c == 1)
-					c = getbits(4) + 3;
-				else
-					c = getbits(CBIT) + 20;
-				while (--c >= 0)
-					c_len[i++] = 0;
-			} else
-				c_len[i++] = c - 2;
-		}
-		while (i < NC)
-			c_len[i++] = 0;
+	int i, c, n;
 
-		if (make_table(NC, c_len, 12, c_table) == -1)
+	n = LZHBitsGet(Decoder, LZH_CBIT);
+	if (!n) {
+		c = LZHBitsGet(Decoder, LZH_CBIT);
+		if (c >= LZH_NC)
 			return -1;
+
+		for (i = 0; i < LZH_NC; i++)
+			Decoder->CLen[i] = 0;
+		for (i = 0; i < (1 << LZH_CTABLE_BITS); i++)
+			Decoder->CTable[i] = c;
+		return 0;
 	}
-	return 0;
-}
 
-static unsigned short decode_c_st1(void)
-{
-	unsigned short j, mask;
-
-	j = c_table[peekbits(12)];
-	if (j < NC)
-		fillbuf(c_len[j]);
-	else {
-		fillbuf(12);
-		mask = 1 << (16 - 1);
-		do {
-			if (bitbuf & mask)
-				j = right[j];
+	if (n > LZH_NC)
+		return -1;
+
+	i = 0;
+	while (i < n) {
+		c = Decoder->PTTable[LZHBitsPeek(Decoder, LZH_PTTABLE_BITS)];
+		if (c >= LZH_NT)
+			c = LZHTreeWalk(Decoder, c, LZH_PTTABLE_BITS, LZH_NT);
+		LZHBitsDrop(Decoder, Decoder->PTLen[c]);
+
+		if (c <= 2) {
+			if (c == 0)
+				c = 1;
+			else if (c == 1)
+				c = LZHBitsGet(Decoder, 4) + 3;
 			else
-				j = left[j];
-			mask >>= 1;
-		} while (j >= NC && (mask || j != left[j]));	/* CVE-2006-4338 */
-		fillbuf(c_len[j] - 12);
+				c = LZHBitsGet(Decoder, LZH_CBIT) + 20;
+
+			if (c > (n - i))
+				return -1;
+			while (--c >= 0)
+				Decoder->CLen[i++] = 0;
+		} else
+			Decoder->CLen[i++] = c - 2;
 	}
-	return j;
+	while (i < LZH_NC)
+		Decoder->CLen[i++] = 0;
+
+	return LZHTableMake(Decoder, LZH_NC, Decoder->CLen, LZH_CTABLE_BITS,
+			    Decoder->CTable);
 }
 
-static unsigned short decode_p_st1(void)
+static int LZHBlockStart(struct LZHDecoder *Decoder, int np, int pbit)
 {
-	unsigned short j, mask;
-
-	j = pt_table[peekbits(8)];
-	if (j < NP)
-		fillbuf(pt_len[j]);
-	else {
-		fillbuf(8);
-		mask = 1 << (16 - 1);
-		do {
-			if (bitbuf & mask)
-				j = right[j];
-			else
-				j = left[j];
-			mask >>= 1;
-		} while (j >= NP && (mask || j != left[j]));	/* CVE-2006-4338 */
-		fillbuf(pt_len[j] - 8);
-	}
-	if (j != 0)
-		j = (1 << (j - 1)) + getbits(j - 1);
-	return j;
+	if (LZHPTLenRead(Decoder, LZH_NT, LZH_TBIT, 3))
+		return -1;
+	if (LZHCLenRead(Decoder))
+		return -1;
+	return LZHPTLenRead(Decoder, np, pbit, -1);
 }
 
-int
-LH5Decode(unsigned char *PackedBuffer, int PackedBufferSize,
-	  unsigned char *OutputBuffer, int OutputBufferSize)
+/*
+ * The decoding loop, to be instantiated with constant arguments: dicbit is
+ * the log2 of the window size, pbit the width of the position set size.
+ * Position codes are read from a table of (1 << pbit) - 1 entries, as the
+ * EFI decoder does.
+ */
+static inline __attribute__ ((always_inline)) int
+LZHDecodeLoop(struct LZHDecoder *Decoder, unsigned char *OutputBuffer,
+	      int OutputBufferSize, const int dicbit, const int pbit)
 {
+	const unsigned int np = (1 << pbit) - 1;
 	unsigned short blocksize = 0;
-	unsigned int i, c;
-	int n = 0;
-
-	BitBufInit(PackedBuffer, PackedBufferSize);
-	fillbuf(2 * 8);
+	unsigned int c, p;
+	int n = 0, length, offset;
 
 	while (n < OutputBufferSize) {
-		if (blocksize == 0) {
-			blocksize = getbits(16);
-
-			if (read_pt_len(NT, TBIT, 3) == -1)
-				return -1;
-			if (read_c_len() == -1)
-				return -1;
-			if (read_pt_len(NP, PBIT, -1) == -1)
+		if (!blocksize) {
+			blocksize = LZHBitsGet(Decoder, 16);
+			if (LZHBlockStart(Decoder, np, pbit))
 				return -1;
 		}
 		blocksize--;
-		c = decode_c_st1();
 
-		if (c < 256)
+		c = Decoder->CTable[LZHBitsPeek(Decoder, LZH_CTABLE_BITS)];
+		if (c >= LZH_NC)
+			c = LZHTreeWalk(Decoder, c, LZH_CTABLE_BITS, LZH_NC);
+		LZHBitsDrop(Decoder, Decoder->CLen[c]);
+
+		if (c < 256) {
 			OutputBuffer[n++] = c;
-		else {
-			int length = c - 256 + THRESHOLD;
-			int offset = 1 + decode_p_st1();
+			continue;
+		}
 
-			if (offset > n)
-				return -1;
+		length = c - 256 + LZH_THRESHOLD;
+
+		p = Decoder->PTTable[LZHBitsPeek(Decoder, LZH_PTTABLE_BITS)];
+		if (p >= np)
+			p = LZHTreeWalk(Decoder, p, LZH_PTTABLE_BITS, np);
+		LZHBitsDrop(Decoder, Decoder->PTLen[p]);
+		if (p > 1)
+			p = (1 << (p - 1)) + LZHBitsGet(Decoder, p - 1);
+
+		offset = p + 1;
+		if ((offset > n) || (offset > (1 << dicbit)))
+			return -1;
+
+		if (length > (OutputBufferSize - n))
+			length = OutputBufferSize - n;
 
-			for (i = 0; i < length; i++) {
+		if (offset >= length) {
+			memcpy(OutputBuffer + n, OutputBuffer + n - offset,
+			       length);
+			n += length;
+		} else
+			while (length--) {
 				OutputBuffer[n] = OutputBuffer[n - offset];
 				n++;
 			}
-		}
 	}
+
+	Decoder->BlockLeft = blocksize;
 	return 0;
 }
+
+static int
+LZHDecodeLH5(struct LZHDecoder *Decoder, unsigned char *OutputBuffer,
+	     int OutputBufferSize)
+{
+	return LZHDecodeLoop(Decoder, OutputBuffer, OutputBufferSize, 13, 4);
+}
+
+static int
+LZHDecodeLH6(struct LZHDecoder *Decoder, unsigned char *OutputBuffer,
+	     int OutputBufferSize)
+{
+	return LZHDecodeLoop(Decoder, OutputBuffer, OutputBufferSize, 15, 5);
+}
+
+static int
+LZHDecodeLH7(struct LZHDecoder *Decoder, unsigned char *OutputBuffer,
+	     int OutputBufferSize)
+{
+	return LZHDecodeLoop(Decoder, OutputBuffer, OutputBufferSize, 16, 5);
+}
+
+static int
+LZHDecodeTiano(struct LZHDecoder *Decoder, unsigned char *OutputBuffer,
+	       int OutputBufferSize)
+{
+	return LZHDecodeLoop(Decoder, OutputBuffer, OutputBufferSize, 19, 5);
+}
+
+/*
+ * Decodes a raw LZH bitstream, without any header. AllUsed tells whether
+ * the stream took up exactly all of the packed data.
+ */
+static int
+LZHDecodeStream(unsigned char *PackedBuffer, int PackedBufferSize,
+		unsigned char *OutputBuffer, int OutputBufferSize, int Method,
+		int *AllUsed)
+{
+	unsigned short Left[2 * LZH_NC - 1], Right[2 * LZH_NC - 1];
+	unsigned short CTable[1 << LZH_CTABLE_BITS];
+	unsigned short PTTable[1 << LZH_PTTABLE_BITS];
+	unsigned char CLen[LZH_NC], PTLen[LZH_NPT];
+	struct LZHDecoder Decoder;
+	int ret;
+
+	Decoder.Left = Left;
+	Decoder.Right = Right;
+	Decoder.CTable = CTable;
+	Decoder.PTTable = PTTable;
+	Decoder.CLen = CLen;
+	Decoder.PTLen = PTLen;
+
+	LZHBitsInit(&Decoder, PackedBuffer, PackedBufferSize);
+
+	switch (Method) {
+	case LZH_METHOD_LH5:
+		ret = LZHDecodeLH5(&Decoder, OutputBuffer, OutputBufferSize);
+		break;
+	case LZH_METHOD_LH6:
+		ret = LZHDecodeLH6(&Decoder, OutputBuffer, OutputBufferSize);
+		break;
+	case LZH_METHOD_LH7:
+		ret = LZHDecodeLH7(&Decoder, OutputBuffer, OutputBufferSize);
+		break;
+	case LZH_METHOD_TIANO:
+		ret = LZHDecodeTiano(&Decoder, OutputBuffer, OutputBufferSize);
+		break;
+	case LZH_METHOD_STORED:
+		if (PackedBufferSize < OutputBufferSize)
+			ret = -1;
+		else {
+			memcpy(OutputBuffer, PackedBuffer, OutputBufferSize);
+			ret = 0;
+		}
+		break;
+	default:
+		fprintf(stderr, "Error: Unknown LZH method %d\n", Method);
+		return -1;
+	}
+
+	*AllUsed = LZHBitsAllUsed(&Decoder);
+	return ret;
+}
+
+int
+LZHDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	  unsigned char *OutputBuffer, int OutputBufferSize, int Method)
+{
+	int ret, AllUsed;
+
+	ret = LZHDecodeStream(PackedBuffer, PackedBufferSize, OutputBuffer,
+			      OutputBufferSize, Method, &AllUsed);
+	if (ret)
+		fprintf(stderr, "Error: Invalid LZH data\n");
+	return ret;
+}
+
+int
+LH5Decode(unsigned char *PackedBuffer, int PackedBufferSize,
+	  unsigned char *OutputBuffer, int OutputBufferSize)
+{
+	return LZHDecode(PackedBuffer, PackedBufferSize, OutputBuffer,
+			 OutputBufferSize, LZH_METHOD_LH5);
+}
+
+/*
+ * Checks whether the position set that follows is valid when its size is
+ * held in pbit bits, and when there are np positions.
+ */
+static int LZHPSetCheck(struct LZHDecoder *Decoder, int pbit, int np)
+{
+	int n = LZHBitsPeek(Decoder, pbit);
+
+	/* a single position, which has to exist */
+	if (!n)
+		return (LZHBitsPeek(Decoder, 2 * pbit) & ((1 << pbit) - 1)) < np;
+
+	if (n > np)
+		return 0;
+
+	return !LZHPTLenRead(Decoder, (1 << pbit) - 1, pbit, -1);
+}
+
+/*
+ * EFI 1.1 and Tiano streams share their header, but the position set of
+ * the first block is described with a 4 bit field by EFI 1.1 and with a 5
+ * bit one by Tiano. Only one of these usually makes up a valid table.
+ */
+static void
+LZHEFIMethodsCheck(unsigned char *PackedBuffer, int PackedBufferSize,
+		   int *IsEfi, int *IsTiano)
+{
+	unsigned short Left[2 * LZH_NC - 1], Right[2 * LZH_NC - 1];
+	unsigned short CTable[1 << LZH_CTABLE_BITS];
+	unsigned short PTTable[1 << LZH_PTTABLE_BITS];
+	unsigned char CLen[LZH_NC], PTLen[LZH_NPT];
+	struct LZHDecoder Decoder, Saved;
+	int Literals, i;
+
+	*IsEfi = *IsTiano = 0;
+
+	Decoder.Left = Left;
+	Decoder.Right = Right;
+	Decoder.CTable = CTable;
+	Decoder.PTTable = PTTable;
+	Decoder.CLen = CLen;
+	Decoder.PTLen = PTLen;
+
+	LZHBitsInit(&Decoder, PackedBuffer, PackedBufferSize);
+
+	/* the block size, the extra set and the character and length set are
+	 * the same for both */
+	LZHBitsDrop(&Decoder, 16);
+	if (LZHPTLenRead(&Decoder, LZH_NT, LZH_TBIT, 3))
+		return;
+	if (LZHCLenRead(&Decoder))
+		return;
+
+	Saved = Decoder;
+	*IsEfi = LZHPSetCheck(&Decoder, 4, 13 + 1);
+	Decoder = Saved;
+	*IsTiano = LZHPSetCheck(&Decoder, 5, 19 + 1);
+	if (!*IsEfi || !*IsTiano)
+		return;
+
+	/*
+	 * Without any lengths in the character set, the block holds no
+	 * positions, and encoders write a single position 0. An EFI 1.1 set
+	 * like that, read as a Tiano one, takes in 2 more bits which are not
+	 * necessarily 0.
+	 */
+	Literals = 1;
+	for (i = 256; i < LZH_NC; i++)
+		if (CLen[i])
+			Literals = 0;
+	for (i = 0; i < 256; i++)
+		if (CLen[i])
+			break;
+	if ((i == 256) && (CTable[0] >= 256))
+		Literals = 0;	/* a set of just one length */
+
+	Decoder = Saved;
+	if (Literals && !LZHBitsPeek(&Decoder, 2 * 4) &&
+	    LZHBitsPeek(&Decoder, 2 * 5))
+		*IsTiano = 0;
+}
+
+/*
+ * Returns LZH_METHOD_LH5 for EFI 1.1, LZH_METHOD_TIANO, or -1. When both
+ * tables are valid, which happens with short streams, Tiano is guessed,
+ * LZHEFIDecode() decides properly.
+ */
+int LZHEFIMethodDetect(unsigned char *PackedBuffer, int PackedBufferSize)
+{
+	int IsEfi, IsTiano;
+
+	LZHEFIMethodsCheck(PackedBuffer, PackedBufferSize, &IsEfi, &IsTiano);
+
+	if (IsTiano)
+		return LZH_METHOD_TIANO;
+	if (IsEfi)
+		return LZH_METHOD_LH5;
+	return -1;
+}
+
+/*
+ * Decodes an EFI 1.1 or a Tiano bitstream, without the header. When both
+ * variants parse, both are decoded, and the one which uses up exactly the
+ * packed size is taken.
+ */
+int
+LZHEFIDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	     unsigned char *OutputBuffer, int OutputBufferSize)
+{
+	int IsEfi, IsTiano, TianoRet = -1, ret, AllUsed;
+
+	LZHEFIMethodsCheck(PackedBuffer, PackedBufferSize, &IsEfi, &IsTiano);
+
+	if (IsTiano) {
+		TianoRet = LZHDecodeStream(PackedBuffer, PackedBufferSize,
+					   OutputBuffer, OutputBufferSize,
+					   LZH_METHOD_TIANO, &AllUsed);
+		if (!TianoRet && (!IsEfi || AllUsed))
+			return 0;
+	}
+
+	if (IsEfi) {
+		ret = LZHDecodeStream(PackedBuffer, PackedBufferSize,
+				      OutputBuffer, OutputBufferSize,
+				      LZH_METHOD_LH5, &AllUsed);
+		if (!ret && (!IsTiano || TianoRet || AllUsed))
+			return 0;
+	}
+
+	/* neither fits the packed size exactly, stick with Tiano */
+	if (IsTiano && !TianoRet)
+		return LZHDecodeStream(PackedBuffer, PackedBufferSize,
+				       OutputBuffer, OutputBufferSize,
+				       LZH_METHOD_TIANO, &AllUsed);
+
+	fprintf(stderr, "Error: Invalid LZH data\n");
+	return -1;
+}
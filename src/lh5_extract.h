@@ -19,13 +19,33 @@
 #ifndef LH5_EXTRACT_H
 #define LH5_EXTRACT_H
 
-unsigned int LH5HeaderParse(unsigned char *Buffer, int BufferSize,
+/*
+ * The LZH variants. EFI 1.1 streams are -lh5- streams, Tiano streams use
+ * a 512kB window.
+ */
+#define LZH_METHOD_LH5		0
+#define LZH_METHOD_LH6		1
+#define LZH_METHOD_LH7		2
+#define LZH_METHOD_TIANO	3
+#define LZH_METHOD_STORED	4	/* -lh0- */
+
+int LHAHeaderCheck(unsigned char *Buffer, int BufferSize);
+
+unsigned int LHAHeaderParse(unsigned char *Buffer, int BufferSize,
 			    unsigned int *original_size,
 			    unsigned int *packed_size,
-			    char **name, unsigned short *crc);
+			    char **name, unsigned short *crc, int *method);
 
 unsigned short CRC16Calculate(unsigned char *Buffer, int BufferSize);
 
+int LZHDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	      unsigned char *OutputBuffer, int OutputBufferSize, int Method);
+
+int LZHEFIMethodDetect(unsigned char *PackedBuffer, int PackedBufferSize);
+
+int LZHEFIDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+		 unsigned char *OutputBuffer, int OutputBufferSize);
+
 int LH5Decode(unsigned char *PackedBuffer, int PackedBufferSize,
 	      unsigned char *OutputBuffer, int OutputBufferSize);
 
@@ -17,7 +17,7 @@
  */
 
 /*
- * Test/Example code for LH5 extraction.
+ * Test/Example code for LHA extraction.
  */
 
 #include <stdio.h>
@@ -35,7 +35,7 @@ int main(int argc, char *argv[])
 	char *filename;
 	unsigned short header_crc;
 	unsigned int header_size, original_size, packed_size;
-	int infd, outfd;
+	int infd, outfd, method;
 	int LHABufferSize = 0;
 	unsigned char *LHABuffer, *OutBuffer;
 
@@ -66,8 +66,9 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	header_size = LH5HeaderParse(LHABuffer, LHABufferSize, &original_size,
-				     &packed_size, &filename, &header_crc);
+	header_size = LHAHeaderParse(LHABuffer, LHABufferSize, &original_size,
+				     &packed_size, &filename, &header_crc,
+				     &method);
 	if (!header_size)
 		return 1;
 
@@ -106,8 +107,8 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	LH5Decode(LHABuffer + header_size, packed_size, OutBuffer,
-		  original_size);
+	LZHDecode(LHABuffer + header_size, packed_size, OutBuffer,
+		  original_size, method);
 
 	if (CRC16Calculate(OutBuffer, original_size) != header_crc) {
 		fprintf(stderr, "Warning: invalid CRC on \"%s\"\n", filename);
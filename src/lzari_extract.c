@@ -0,0 +1,274 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * LZARI decompression, as in Haruhiko Okumura's LZARI.C: LZSS with a 4kB
+ * window, where literals, match lengths and match positions are coded by
+ * an adaptive arithmetic coder. The symbol and position models are
+ * cumulative frequency tables, which the decoder binary searches.
+ *
+ * All state lives in a context on the stack of the caller.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "lzari_extract.h"
+
+#define LZARI_N 4096		/* window size */
+#define LZARI_F 60		/* longest match */
+#define LZARI_THRESHOLD 2	/* matches have to be longer than this */
+#define LZARI_N_CHAR (256 - LZARI_THRESHOLD + LZARI_F)
+
+#define LZARI_M 15
+#define LZARI_Q1 (1UL << LZARI_M)
+#define LZARI_Q2 (2 * LZARI_Q1)
+#define LZARI_Q3 (3 * LZARI_Q1)
+#define LZARI_Q4 (4 * LZARI_Q1)
+#define LZARI_MAX_CUM (LZARI_Q1 - 1)
+
+struct LZARIContext {
+	unsigned char *Input;
+	int InputSize;
+	int InputBit;		/* in bits */
+
+	uint32_t Low, High, Value;
+
+	uint16_t CharToSym[LZARI_N_CHAR];
+	uint16_t SymToChar[LZARI_N_CHAR + 1];
+	uint16_t SymFreq[LZARI_N_CHAR + 1];
+	uint16_t SymCum[LZARI_N_CHAR + 1];
+	uint16_t PositionCum[LZARI_N + 1];
+
+	unsigned char Window[LZARI_N];
+};
+
+/* Past the end of the input, the coder is fed zeroes. */
+static inline int LZARIBit(struct LZARIContext *Context)
+{
+	int Bit = 0;
+
+	if ((Context->InputBit >> 3) < Context->InputSize)
+		Bit = (Context->Input[Context->InputBit >> 3] >>
+		       (7 - (Context->InputBit & 7))) & 1;
+	Context->InputBit++;
+
+	return Bit;
+}
+
+static void LZARIModelStart(struct LZARIContext *Context)
+{
+	int Sym, i;
+
+	Context->SymCum[LZARI_N_CHAR] = 0;
+	for (Sym = LZARI_N_CHAR; Sym >= 1; Sym--) {
+		Context->CharToSym[Sym - 1] = Sym;
+		Context->SymToChar[Sym] = Sym - 1;
+		Context->SymFreq[Sym] = 1;
+		Context->SymCum[Sym - 1] = Context->SymCum[Sym] + 1;
+	}
+	Context->SymFreq[0] = 0;
+
+	Context->PositionCum[LZARI_N] = 0;
+	for (i = LZARI_N; i >= 1; i--)
+		Context->PositionCum[i - 1] = Context->PositionCum[i] +
+		    10000 / (i + 200);
+}
+
+static void LZARIModelUpdate(struct LZARIContext *Context, int Sym)
+{
+	int i, c, Char, SymChar;
+
+	if (Context->SymCum[0] >= LZARI_MAX_CUM) {
+		c = 0;
+		for (i = LZARI_N_CHAR; i > 0; i--) {
+			Context->SymCum[i] = c;
+			Context->SymFreq[i] = (Context->SymFreq[i] + 1) >> 1;
+			c += Context->SymFreq[i];
+		}
+		Context->SymCum[0] = c;
+	}
+
+	for (i = Sym; Context->SymFreq[i] == Context->SymFreq[i - 1]; i--) ;
+
+	if (i < Sym) {
+		Char = Context->SymToChar[i];
+		SymChar = Context->SymToChar[Sym];
+		Context->SymToChar[i] = SymChar;
+		Context->SymToChar[Sym] = Char;
+		Context->CharToSym[Char] = Sym;
+		Context->CharToSym[SymChar] = i;
+	}
+
+	Context->SymFreq[i]++;
+	while (--i >= 0)
+		Context->SymCum[i]++;
+}
+
+/*
+ * Both tables are in descending order, find the entry x falls in.
+ */
+static int LZARISymSearch(struct LZARIContext *Context, uint32_t x)
+{
+	int i = 1, j = LZARI_N_CHAR, k;
+
+	while (i < j) {
+		k = (i + j) / 2;
+		if (Context->SymCum[k] > x)
+			i = k + 1;
+		else
+			j = k;
+	}
+
+	return i;
+}
+
+static int LZARIPositionSearch(struct LZARIContext *Context, uint32_t x)
+{
+	int i = 1, j = LZARI_N, k;
+
+	while (i < j) {
+		k = (i + j) / 2;
+		if (Context->PositionCum[k] > x)
+			i = k + 1;
+		else
+			j = k;
+	}
+
+	return i - 1;
+}
+
+/*
+ * Narrow the interval down to [CumHigh, CumLow) of Total, and shift out
+ * the settled bits.
+ */
+static void
+LZARINarrow(struct LZARIContext *Context, uint32_t Range, uint32_t CumHigh,
+	    uint32_t CumLow, uint32_t Total)
+{
+	Context->High = Context->Low + (Range * CumHigh) / Total;
+	Context->Low += (Range * CumLow) / Total;
+
+	for (;;) {
+		if (Context->Low >= LZARI_Q2) {
+			Context->Value -= LZARI_Q2;
+			Context->Low -= LZARI_Q2;
+			Context->High -= LZARI_Q2;
+		} else if ((Context->Low >= LZARI_Q1) &&
+			   (Context->High <= LZARI_Q3)) {
+			Context->Value -= LZARI_Q1;
+			Context->Low -= LZARI_Q1;
+			Context->High -= LZARI_Q1;
+		} else if (Context->High > LZARI_Q2)
+			break;
+
+		Context->Low += Context->Low;
+		Context->High += Context->High;
+		Context->Value = 2 * Context->Value + LZARIBit(Context);
+	}
+}
+
+static int LZARICharDecode(struct LZARIContext *Context)
+{
+	uint32_t Range = Context->High - Context->Low;
+	uint32_t Total = Context->SymCum[0];
+	int Sym, Char;
+
+	Sym = LZARISymSearch(Context, ((Context->Value - Context->Low + 1) *
+					Total - 1) / Range);
+	LZARINarrow(Context, Range, Context->SymCum[Sym - 1],
+		    Context->SymCum[Sym], Total);
+
+	Char = Context->SymToChar[Sym];
+	LZARIModelUpdate(Context, Sym);
+
+	return Char;
+}
+
+static int LZARIPositionDecode(struct LZARIContext *Context)
+{
+	uint32_t Range = Context->High - Context->Low;
+	uint32_t Total = Context->PositionCum[0];
+	int Position;
+
+	Position = LZARIPositionSearch(Context, ((Context->Value -
+						  Context->Low + 1) * Total -
+						 1) / Range);
+	LZARINarrow(Context, Range, Context->PositionCum[Position],
+		    Context->PositionCum[Position + 1], Total);
+
+	return Position;
+}
+
+/*
+ * Decodes a raw LZARI bitstream, without Okumura's 4 byte length in front,
+ * until OutputBufferSize bytes are produced. The window starts out filled
+ * with spaces. Returns 0, or -1 when the input runs out early.
+ */
+int
+LZARIDecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	    unsigned char *OutputBuffer, int OutputBufferSize)
+{
+	struct LZARIContext Context;
+	int Offset = 0, Char, Start, Length, r, i;
+
+	Context.Input = PackedBuffer;
+	Context.InputSize = PackedBufferSize;
+	Context.InputBit = 0;
+
+	Context.Low = 0;
+	Context.High = LZARI_Q4;
+	Context.Value = 0;
+	for (i = 0; i < (LZARI_M + 2); i++)
+		Context.Value = 2 * Context.Value + LZARIBit(&Context);
+
+	LZARIModelStart(&Context);
+
+	memset(Context.Window, ' ', LZARI_N - LZARI_F);
+	memset(Context.Window + LZARI_N - LZARI_F, 0, LZARI_F);
+	r = LZARI_N - LZARI_F;
+
+	while (Offset < OutputBufferSize) {
+		/* the coder only ever needs a few bits of slack */
+		if ((Context.InputBit >> 3) > (PackedBufferSize + 4)) {
+			fprintf(stderr, "Error: LZARI data ends early\n");
+			return -1;
+		}
+
+		Char = LZARICharDecode(&Context);
+		if (Char < 256) {
+			OutputBuffer[Offset++] = Char;
+			Context.Window[r] = Char;
+			r = (r + 1) & (LZARI_N - 1);
+			continue;
+		}
+
+		Start = (r - LZARIPositionDecode(&Context) - 1) & (LZARI_N - 1);
+		Length = Char - 255 + LZARI_THRESHOLD;
+		if (Length > (OutputBufferSize - Offset))
+			Length = OutputBufferSize - Offset;
+
+		for (i = 0; i < Length; i++) {
+			Char = Context.Window[(Start + i) & (LZARI_N - 1)];
+			OutputBuffer[Offset++] = Char;
+			Context.Window[r] = Char;
+			r = (r + 1) & (LZARI_N - 1);
+		}
+	}
+
+	return 0;
+}
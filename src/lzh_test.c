@@ -0,0 +1,158 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Known-answer tests for the LH5/LH6/LH7, EFI 1.1 and Tiano decoders.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lh5_extract.h"
+#include "efi_extract.h"
+
+static unsigned char Text[] =
+    "the quick brown fox jumps over the lazy dog, "
+    "the quick brown fox jumps over the lazy dog again";
+
+static unsigned char PackedLH5[] = {
+	0x00, 0x31, 0x48, 0xAE, 0xB0, 0xA9, 0x2E, 0x06, 0x7F, 0xD1, 0x61, 0x07,
+	0x54, 0x92, 0x87, 0x00, 0x0C, 0x72, 0x30, 0x34, 0xE0, 0x00, 0x91, 0x97,
+	0xA8, 0x0F, 0x9A, 0xBA, 0xFC, 0x73, 0x03, 0xAB, 0x47, 0x87, 0x61, 0xF4,
+	0xD8, 0xE8, 0x83, 0xA2, 0x20, 0x33, 0xF2, 0xCB, 0x17, 0x1D, 0x9A, 0x78,
+	0xD5, 0x76, 0x60, 0x24, 0x92, 0x9A,
+};
+
+static unsigned char PackedLH6[] = {
+	0x00, 0x31, 0x48, 0xAE, 0xB0, 0xA9, 0x2E, 0x06, 0x7F, 0xD1, 0x61, 0x07,
+	0x54, 0x92, 0x87, 0x00, 0x0C, 0x72, 0x30, 0x34, 0x70, 0x00, 0x48, 0xCB,
+	0xD4, 0x07, 0xCD, 0x5D, 0x7E, 0x39, 0x81, 0xD5, 0xA3, 0xC3, 0xB0, 0xFA,
+	0x6C, 0x74, 0x41, 0xD1, 0x10, 0x19, 0xF9, 0x65, 0x8B, 0x8E, 0xCD, 0x3C,
+	0x6A, 0xBB, 0x30, 0x12, 0x49, 0x4D,
+};
+
+static unsigned char PackedLH7[] = {
+	0x00, 0x31, 0x48, 0xAE, 0xB0, 0xA9, 0x2E, 0x06, 0x7F, 0xD1, 0x61, 0x07,
+	0x54, 0x92, 0x87, 0x00, 0x0C, 0x72, 0x30, 0x34, 0x70, 0x00, 0x48, 0xCB,
+	0xD4, 0x07, 0xCD, 0x5D, 0x7E, 0x39, 0x81, 0xD5, 0xA3, 0xC3, 0xB0, 0xFA,
+	0x6C, 0x74, 0x41, 0xD1, 0x10, 0x19, 0xF9, 0x65, 0x8B, 0x8E, 0xCD, 0x3C,
+	0x6A, 0xBB, 0x30, 0x12, 0x49, 0x4D,
+};
+
+static unsigned char PackedEFI[] = {
+	0x36, 0x00, 0x00, 0x00, 0x5E, 0x00, 0x00, 0x00, 0x00, 0x31, 0x48, 0xAE,
+	0xB0, 0xA9, 0x2E, 0x06, 0x7F, 0xD1, 0x61, 0x07, 0x54, 0x92, 0x87, 0x00,
+	0x0C, 0x72, 0x30, 0x34, 0xE0, 0x00, 0x91, 0x97, 0xA8, 0x0F, 0x9A, 0xBA,
+	0xFC, 0x73, 0x03, 0xAB, 0x47, 0x87, 0x61, 0xF4, 0xD8, 0xE8, 0x83, 0xA2,
+	0x20, 0x33, 0xF2, 0xCB, 0x17, 0x1D, 0x9A, 0x78, 0xD5, 0x76, 0x60, 0x24,
+	0x92, 0x9A,
+};
+
+static unsigned char PackedTiano[] = {
+	0x36, 0x00, 0x00, 0x00, 0x5E, 0x00, 0x00, 0x00, 0x00, 0x31, 0x48, 0xAE,
+	0xB0, 0xA9, 0x2E, 0x06, 0x7F, 0xD1, 0x61, 0x07, 0x54, 0x92, 0x87, 0x00,
+	0x0C, 0x72, 0x30, 0x34, 0x70, 0x00, 0x48, 0xCB, 0xD4, 0x07, 0xCD, 0x5D,
+	0x7E, 0x39, 0x81, 0xD5, 0xA3, 0xC3, 0xB0, 0xFA, 0x6C, 0x74, 0x41, 0xD1,
+	0x10, 0x19, 0xF9, 0x65, 0x8B, 0x8E, 0xCD, 0x3C, 0x6A, 0xBB, 0x30, 0x12,
+	0x49, 0x4D,
+};
+
+/*
+ * Both of these parse as either variant and decode to "aaaa"; only the
+ * last byte, the position set, tells them apart.
+ */
+static unsigned char PackedShortEFI[] = {
+	0x0A, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20, 0x04,
+	0x30, 0x11, 0x36, 0x45, 0x40, 0x10,
+};
+
+static unsigned char PackedShortTiano[] = {
+	0x0A, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20, 0x04,
+	0x30, 0x11, 0x36, 0x45, 0x40, 0x04,
+};
+
+static unsigned char PackedShortTiano2[] = {
+	0x09, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x04, 0x20, 0x04,
+	0x26, 0x31, 0x37, 0x00, 0x20,
+};
+
+struct LZHTest {
+	char *Name;
+	int Method;		/* LZH_METHOD_* or -1 for EFIDecode */
+	int Version;		/* EFI_COMPRESSION_* */
+	unsigned char *Packed;
+	int PackedSize;
+	unsigned char *Expected;
+	int ExpectedSize;
+};
+
+#define LZH_TEST(Name, Method, Version, Packed, Expected) \
+	{ Name, Method, Version, Packed, sizeof(Packed), \
+	  (unsigned char *) Expected, sizeof(Expected) - 1 }
+
+static struct LZHTest LZHTests[] = {
+	LZH_TEST("LH5", LZH_METHOD_LH5, 0, PackedLH5, Text),
+	LZH_TEST("LH6", LZH_METHOD_LH6, 0, PackedLH6, Text),
+	LZH_TEST("LH7", LZH_METHOD_LH7, 0, PackedLH7, Text),
+	LZH_TEST("EFI 1.1", -1, EFI_COMPRESSION_EFI, PackedEFI, Text),
+	LZH_TEST("EFI 1.1 detect", -1, EFI_COMPRESSION_DETECT, PackedEFI, Text),
+	LZH_TEST("Tiano", -1, EFI_COMPRESSION_TIANO, PackedTiano, Text),
+	LZH_TEST("Tiano detect", -1, EFI_COMPRESSION_DETECT, PackedTiano, Text),
+	LZH_TEST("EFI 1.1 short", -1, EFI_COMPRESSION_EFI, PackedShortEFI,
+		 "aaaa"),
+	LZH_TEST("EFI 1.1 short detect", -1, EFI_COMPRESSION_DETECT,
+		 PackedShortEFI, "aaaa"),
+	LZH_TEST("Tiano short", -1, EFI_COMPRESSION_TIANO, PackedShortTiano,
+		 "aaaa"),
+	LZH_TEST("Tiano short detect", -1, EFI_COMPRESSION_DETECT,
+		 PackedShortTiano, "aaaa"),
+	LZH_TEST("Tiano short tie detect", -1, EFI_COMPRESSION_DETECT,
+		 PackedShortTiano2, "baaa"),
+	{ NULL, 0, 0, NULL, 0, NULL, 0 }
+};
+
+int main(int argc, char *argv[])
+{
+	unsigned char Output[256];
+	struct LZHTest *Test;
+	int Failed = 0, ret;
+
+	for (Test = LZHTests; Test->Name; Test++) {
+		memset(Output, 0xAA, sizeof(Output));
+
+		if (Test->Method == -1)
+			ret = EFIDecode(Test->Packed, Test->PackedSize, Output,
+					Test->ExpectedSize, Test->Version);
+		else
+			ret = LZHDecode(Test->Packed, Test->PackedSize, Output,
+					Test->ExpectedSize, Test->Method);
+
+		if (ret || memcmp(Output, Test->Expected, Test->ExpectedSize)) {
+			fprintf(stderr, "Error: %s: wrong output\n", Test->Name);
+			Failed++;
+		} else
+			printf("%s: ok\n", Test->Name);
+	}
+
+	if (Failed) {
+		fprintf(stderr, "Error: %d of %d tests failed.\n", Failed,
+			(int) (Test - LZHTests));
+		return 1;
+	}
+
+	return 0;
+}
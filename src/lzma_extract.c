@@ -0,0 +1,622 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * LZMA decompression, as used by Insyde images and by UEFI LZMA compressed
+ * sections. Streams come in the "LZMA alone" format: a properties byte, the
+ * 32bit dictionary size and the 64bit uncompressed size, followed by the
+ * range coded data.
+ *
+ * All decoder state lives in a context on the stack of the caller, and the
+ * output buffer doubles as the dictionary, so this is safe to call from any
+ * number of threads at once.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "compat.h"
+#include "bios_extract.h"
+#include "lzma_extract.h"
+
+#define LZMA_PROPERTIES_MAX (9 * 5 * 5)
+
+/* largest module we are willing to believe in */
+#define LZMA_SIZE_MAX 0x10000000
+
+#define LZMA_BIT_MODEL_TOTAL_BITS 11
+#define LZMA_BIT_MODEL_TOTAL (1 << LZMA_BIT_MODEL_TOTAL_BITS)
+#define LZMA_MOVE_BITS 5
+#define LZMA_TOP_VALUE (1 << 24)
+
+#define LZMA_STATES 12
+#define LZMA_POS_BITS_MAX 4
+#define LZMA_LEN_TO_POS_STATES 4
+#define LZMA_ALIGN_BITS 4
+#define LZMA_END_POS_MODEL_INDEX 14
+#define LZMA_FULL_DISTANCES (1 << (LZMA_END_POS_MODEL_INDEX >> 1))
+#define LZMA_MATCH_MIN_LEN 2
+
+/* length decoder: choice bits, then 3bit low and mid trees, 8bit high tree */
+#define LZMA_LEN_CHOICE 0
+#define LZMA_LEN_CHOICE2 1
+#define LZMA_LEN_LOW 2
+#define LZMA_LEN_MID (LZMA_LEN_LOW + (1 << (LZMA_POS_BITS_MAX + 3)))
+#define LZMA_LEN_HIGH (LZMA_LEN_MID + (1 << (LZMA_POS_BITS_MAX + 3)))
+#define LZMA_LEN_PROBS (LZMA_LEN_HIGH + (1 << 8))
+
+/* layout of the probability array */
+#define LZMA_IS_MATCH 0
+#define LZMA_IS_REP (LZMA_IS_MATCH + (LZMA_STATES << LZMA_POS_BITS_MAX))
+#define LZMA_IS_REP_G0 (LZMA_IS_REP + LZMA_STATES)
+#define LZMA_IS_REP_G1 (LZMA_IS_REP_G0 + LZMA_STATES)
+#define LZMA_IS_REP_G2 (LZMA_IS_REP_G1 + LZMA_STATES)
+#define LZMA_IS_REP0_LONG (LZMA_IS_REP_G2 + LZMA_STATES)
+#define LZMA_POS_SLOT (LZMA_IS_REP0_LONG + (LZMA_STATES << LZMA_POS_BITS_MAX))
+#define LZMA_SPEC_POS (LZMA_POS_SLOT + (LZMA_LEN_TO_POS_STATES << 6))
+#define LZMA_ALIGN (LZMA_SPEC_POS + 1 + LZMA_FULL_DISTANCES - LZMA_END_POS_MODEL_INDEX)
+#define LZMA_LEN_CODER (LZMA_ALIGN + (1 << LZMA_ALIGN_BITS))
+#define LZMA_REP_LEN_CODER (LZMA_LEN_CODER + LZMA_LEN_PROBS)
+#define LZMA_LITERAL (LZMA_REP_LEN_CODER + LZMA_LEN_PROBS)
+
+struct LZMAContext {
+	unsigned char *Input;
+	int InputSize;
+	int InputOffset;
+	uint32_t Range;
+	uint32_t Code;
+	Bool Error;
+
+	int lc, lp, pb;
+	uint16_t *Probs;
+};
+
+static inline void LZMANormalize(struct LZMAContext *Context)
+{
+	if (Context->Range >= LZMA_TOP_VALUE)
+		return;
+
+	if (Context->InputOffset >= Context->InputSize) {
+		Context->Error = TRUE;
+		return;
+	}
+
+	Context->Range <<= 8;
+	Context->Code = (Context->Code << 8) |
+	    Context->Input[Context->InputOffset++];
+}
+
+static inline int LZMABit(struct LZMAContext *Context, uint16_t *Prob)
+{
+	uint32_t Bound = (Context->Range >> LZMA_BIT_MODEL_TOTAL_BITS) * *Prob;
+	int Bit;
+
+	if (Context->Code < Bound) {
+		Context->Range = Bound;
+		*Prob += (LZMA_BIT_MODEL_TOTAL - *Prob) >> LZMA_MOVE_BITS;
+		Bit = 0;
+	} else {
+		Context->Range -= Bound;
+		Context->Code -= Bound;
+		*Prob -= *Prob >> LZMA_MOVE_BITS;
+		Bit = 1;
+	}
+
+	LZMANormalize(Context);
+	return Bit;
+}
+
+static uint32_t LZMADirectBits(struct LZMAContext *Context, int Count)
+{
+	uint32_t Result = 0, Mask;
+
+	while (Count--) {
+		Context->Range >>= 1;
+		Context->Code -= Context->Range;
+		Mask = 0 - (Context->Code >> 31);
+		Context->Code += Context->Range & Mask;
+		Result = (Result << 1) + (Mask + 1);
+		LZMANormalize(Context);
+	}
+
+	return Result;
+}
+
+static uint32_t
+LZMABitTree(struct LZMAContext *Context, uint16_t *Probs, int Bits)
+{
+	uint32_t m = 1;
+	int i;
+
+	for (i = 0; i < Bits; i++)
+		m = (m << 1) + LZMABit(Context, Probs + m);
+
+	return m - (1 << Bits);
+}
+
+static uint32_t
+LZMABitTreeReverse(struct LZMAContext *Context, uint16_t *Probs, int Bits)
+{
+	uint32_t m = 1, Symbol = 0;
+	int i, Bit;
+
+	for (i = 0; i < Bits; i++) {
+		Bit = LZMABit(Context, Probs + m);
+		m = (m << 1) + Bit;
+		Symbol |= Bit << i;
+	}
+
+	return Symbol;
+}
+
+static uint32_t
+LZMALength(struct LZMAContext *Context, uint16_t *Probs, int PosState)
+{
+	if (!LZMABit(Context, Probs + LZMA_LEN_CHOICE))
+		return LZMABitTree(Context, Probs + LZMA_LEN_LOW + (PosState << 3),
+				   3);
+	if (!LZMABit(Context, Probs + LZMA_LEN_CHOICE2))
+		return 8 + LZMABitTree(Context,
+				       Probs + LZMA_LEN_MID + (PosState << 3), 3);
+	return 16 + LZMABitTree(Context, Probs + LZMA_LEN_HIGH, 8);
+}
+
+static uint32_t LZMADistance(struct LZMAContext *Context, uint32_t Length)
+{
+	uint32_t PosSlot, Distance;
+	int DirectBits;
+
+	if (Length > (LZMA_LEN_TO_POS_STATES - 1))
+		Length = LZMA_LEN_TO_POS_STATES - 1;
+
+	PosSlot = LZMABitTree(Context, Context->Probs + LZMA_POS_SLOT +
+			      (Length << 6), 6);
+	if (PosSlot < 4)
+		return PosSlot;
+
+	DirectBits = (PosSlot >> 1) - 1;
+	Distance = (2 | (PosSlot & 1)) << DirectBits;
+
+	if (PosSlot < LZMA_END_POS_MODEL_INDEX)
+		return Distance +
+		    LZMABitTreeReverse(Context, Context->Probs + LZMA_SPEC_POS +
+				       Distance - PosSlot, DirectBits);
+
+	Distance += LZMADirectBits(Context, DirectBits - LZMA_ALIGN_BITS) <<
+	    LZMA_ALIGN_BITS;
+	return Distance + LZMABitTreeReverse(Context, Context->Probs + LZMA_ALIGN,
+					     LZMA_ALIGN_BITS);
+}
+
+/*
+ * Returns the size of the header, or 0 when Buffer does not start with a
+ * sane one. Streams of unknown length, which rely on an end marker, have
+ * their size set to LZMA_SIZE_UNKNOWN.
+ */
+int LZMAHeaderParse(unsigned char *Buffer, int BufferSize,
+		    unsigned int *original_size,
+		    unsigned int *dictionary_size)
+{
+	if (BufferSize < LZMA_HEADER_SIZE)
+		return 0;
+
+	if (Buffer[0] >= LZMA_PROPERTIES_MAX)
+		return 0;
+
+	*dictionary_size = Buffer[1] | (Buffer[2] << 8) | (Buffer[3] << 16) |
+	    (Buffer[4] << 24);
+	*original_size = Buffer[5] | (Buffer[6] << 8) | (Buffer[7] << 16) |
+	    (Buffer[8] << 24);
+
+	if ((*original_size == LZMA_SIZE_UNKNOWN) && (Buffer[9] == 0xFF) &&
+	    (Buffer[10] == 0xFF) && (Buffer[11] == 0xFF) && (Buffer[12] == 0xFF))
+		return LZMA_HEADER_SIZE;
+
+	if (Buffer[9] || Buffer[10] || Buffer[11] || Buffer[12])
+		return 0;
+
+	if (*original_size > LZMA_SIZE_MAX)
+		return 0;
+
+	return LZMA_HEADER_SIZE;
+}
+
+/*
+ * Make room for Needed bytes in a buffer which is allowed to grow up to Max
+ * bytes, by doubling it. Buffers which may not grow have Max set to their
+ * size.
+ */
+static Bool
+LZMAOutputGrow(unsigned char **Buffer, int *Size, uint32_t Needed, int Max)
+{
+	unsigned char *New;
+	uint32_t NewSize = *Size;
+
+	if (Needed <= NewSize)
+		return TRUE;
+	if (Needed > Max)
+		return FALSE;
+
+	if (NewSize < 0x1000)
+		NewSize = 0x1000;
+	while (NewSize < Needed)
+		NewSize <<= 1;
+	if (NewSize > Max)
+		NewSize = Max;
+
+	New = realloc(*Buffer, NewSize);
+	if (!New) {
+		fprintf(stderr, "Error: Out of memory for %d bytes of LZMA "
+			"data\n", NewSize);
+		return FALSE;
+	}
+
+	*Buffer = New;
+	*Size = NewSize;
+	return TRUE;
+}
+
+/*
+ * Decodes the stream behind the header into OutputBuffer. With EndMarker,
+ * the stream has to end with an end marker, otherwise decoding stops after
+ * OutputBufferSize bytes. When OutputBufferMax is larger than
+ * OutputBufferSize, OutputBuffer is allocated and gets grown on the way,
+ * otherwise everything has to fit the buffer as it is. Returns the number
+ * of packed bytes used and the number of bytes produced in Produced, -1 for
+ * a broken stream, or -2 when it does not fit.
+ */
+static int
+LZMADecodeStream(unsigned char *PackedBuffer, int PackedBufferSize,
+		 unsigned char **Output, int *OutputSize, int OutputBufferMax,
+		 Bool EndMarker, int *Produced)
+{
+	unsigned char *OutputBuffer = *Output;
+	int OutputBufferSize = *OutputSize;
+	struct LZMAContext Context;
+	uint32_t Rep0 = 0, Rep1 = 0, Rep2 = 0, Rep3 = 0, Length, Symbol;
+	uint32_t PosMask, LiteralMask, Offset = 0;
+	int State = 0, PosState, NumProbs, i;
+	unsigned char Previous = 0, Match;
+	uint16_t *Probs;
+	int Bit, MatchBit;
+	Bool Ended = FALSE, Full = FALSE;
+
+	memset(&Context, 0, sizeof(Context));
+	Context.lc = PackedBuffer[0] % 9;
+	Context.lp = (PackedBuffer[0] / 9) % 5;
+	Context.pb = PackedBuffer[0] / 45;
+
+	/* the range coder always starts out with a 0 byte */
+	if (PackedBufferSize < (LZMA_HEADER_SIZE + 5) ||
+	    PackedBuffer[LZMA_HEADER_SIZE])
+		return -1;
+
+	Context.Input = PackedBuffer;
+	Context.InputSize = PackedBufferSize;
+	Context.InputOffset = LZMA_HEADER_SIZE + 5;
+	Context.Range = 0xFFFFFFFF;
+	Context.Code = (PackedBuffer[LZMA_HEADER_SIZE + 1] << 24) |
+	    (PackedBuffer[LZMA_HEADER_SIZE + 2] << 16) |
+	    (PackedBuffer[LZMA_HEADER_SIZE + 3] << 8) |
+	    PackedBuffer[LZMA_HEADER_SIZE + 4];
+	if (Context.Code == Context.Range)
+		return -1;
+
+	NumProbs = LZMA_LITERAL + (0x300 << (Context.lc + Context.lp));
+	Context.Probs = malloc(NumProbs * sizeof(uint16_t));
+	if (!Context.Probs) {
+		fprintf(stderr, "Error: Out of memory for the LZMA decoder\n");
+		return -1;
+	}
+	Probs = Context.Probs;
+	for (i = 0; i < NumProbs; i++)
+		Probs[i] = LZMA_BIT_MODEL_TOTAL >> 1;
+
+	PosMask = (1 << Context.pb) - 1;
+	LiteralMask = (1 << Context.lp) - 1;
+
+	while ((EndMarker || (Offset < OutputBufferSize)) && !Context.Error) {
+		PosState = Offset & PosMask;
+
+		if (!LZMABit(&Context, Probs + LZMA_IS_MATCH +
+			     (State << LZMA_POS_BITS_MAX) + PosState)) {
+			uint16_t *Literal = Probs + LZMA_LITERAL + 0x300 *
+			    (((Offset & LiteralMask) << Context.lc) +
+			     (Previous >> (8 - Context.lc)));
+
+			Symbol = 1;
+			if (State >= 7) {
+				Match = OutputBuffer[Offset - Rep0 - 1];
+				do {
+					MatchBit = (Match >> 7) & 1;
+					Match <<= 1;
+					Bit = LZMABit(&Context, Literal + 0x100 +
+						      (MatchBit << 8) + Symbol);
+					Symbol = (Symbol << 1) | Bit;
+				} while ((Symbol < 0x100) && (Bit == MatchBit));
+			}
+			while (Symbol < 0x100)
+				Symbol = (Symbol << 1) |
+				    LZMABit(&Context, Literal + Symbol);
+
+			if (!LZMAOutputGrow(&OutputBuffer, &OutputBufferSize,
+					    Offset + 1, OutputBufferMax)) {
+				Full = TRUE;
+				break;
+			}
+			Previous = Symbol;
+			OutputBuffer[Offset++] = Previous;
+
+			if (State < 4)
+				State = 0;
+			else if (State < 10)
+				State -= 3;
+			else
+				State -= 6;
+			continue;
+		}
+
+		if (!LZMABit(&Context, Probs + LZMA_IS_REP + State)) {
+			/* simple match */
+			Rep3 = Rep2;
+			Rep2 = Rep1;
+			Rep1 = Rep0;
+			Length = LZMALength(&Context, Probs + LZMA_LEN_CODER,
+					    PosState);
+			State = (State < 7) ? 7 : 10;
+			Rep0 = LZMADistance(&Context, Length);
+			if (Rep0 == 0xFFFFFFFF) {
+				Ended = TRUE;	/* end marker */
+				break;
+			}
+		} else {
+			if (!LZMABit(&Context, Probs + LZMA_IS_REP_G0 + State)) {
+				if (!LZMABit(&Context, Probs + LZMA_IS_REP0_LONG +
+					     (State << LZMA_POS_BITS_MAX) +
+					     PosState)) {
+					/* short rep: a single byte */
+					if (!Offset) {
+						Context.Error = TRUE;
+						break;
+					}
+					if (!LZMAOutputGrow(&OutputBuffer,
+							    &OutputBufferSize,
+							    Offset + 1,
+							    OutputBufferMax)) {
+						Full = TRUE;
+						break;
+					}
+					State = (State < 7) ? 9 : 11;
+					Previous = OutputBuffer[Offset - Rep0 - 1];
+					OutputBuffer[Offset++] = Previous;
+					continue;
+				}
+			} else {
+				uint32_t Distance;
+
+				if (!LZMABit(&Context, Probs + LZMA_IS_REP_G1 + State))
+					Distance = Rep1;
+				else {
+					if (!LZMABit(&Context,
+						     Probs + LZMA_IS_REP_G2 + State))
+						Distance = Rep2;
+					else {
+						Distance = Rep3;
+						Rep3 = Rep2;
+					}
+					Rep2 = Rep1;
+				}
+				Rep1 = Rep0;
+				Rep0 = Distance;
+			}
+			Length = LZMALength(&Context, Probs + LZMA_REP_LEN_CODER,
+					    PosState);
+			State = (State < 7) ? 8 : 11;
+		}
+
+		if (Rep0 >= Offset) {
+			Context.Error = TRUE;
+			break;
+		}
+
+		Length += LZMA_MATCH_MIN_LEN;
+		if (!LZMAOutputGrow(&OutputBuffer, &OutputBufferSize,
+				    Offset + Length, OutputBufferMax)) {
+			Full = TRUE;
+			break;
+		}
+
+		for (; Length; Length--, Offset++)
+			OutputBuffer[Offset] = OutputBuffer[Offset - Rep0 - 1];
+		Previous = OutputBuffer[Offset - 1];
+	}
+
+	free(Context.Probs);
+	*Output = OutputBuffer;
+	*OutputSize = OutputBufferSize;
+
+	if (Context.Error)
+		return -1;
+	if (Full)
+		return -2;
+	if (EndMarker && !Ended)
+		return -1;
+
+	*Produced = Offset;
+	return Context.InputOffset;
+}
+
+/*
+ * Decodes a complete stream, header included, into OutputBuffer which has to
+ * be exactly the size of the expanded data, see LZMAExpandedSize(). Returns
+ * the number of packed bytes used, or -1.
+ */
+int
+LZMADecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	   unsigned char *OutputBuffer, int OutputBufferSize)
+{
+	unsigned int original_size, dictionary_size;
+	int ret, Produced;
+
+	if (!LZMAHeaderParse(PackedBuffer, PackedBufferSize, &original_size,
+			     &dictionary_size))
+		return -1;
+
+	if ((original_size != LZMA_SIZE_UNKNOWN) &&
+	    (original_size != OutputBufferSize))
+		return -1;
+
+	ret = LZMADecodeStream(PackedBuffer, PackedBufferSize, &OutputBuffer,
+			       &OutputBufferSize, OutputBufferSize,
+			       original_size == LZMA_SIZE_UNKNOWN, &Produced);
+	if ((ret < 0) || (Produced != OutputBufferSize))
+		return -1;
+
+	return ret;
+}
+
+/*
+ * Decodes a complete stream, header included, into a buffer of its own.
+ * For streams of unknown length, that buffer starts out small and grows
+ * while decoding, up to MaxSize, so that they only get decoded once.
+ * Returns the number of packed bytes used, and the buffer and the size of
+ * the expanded data in OutputBuffer and OutputBufferSize, or -1.
+ */
+int
+LZMADecodeAlloc(unsigned char *PackedBuffer, int PackedBufferSize,
+		unsigned char **OutputBuffer, int *OutputBufferSize,
+		int MaxSize)
+{
+	unsigned int original_size, dictionary_size;
+	unsigned char *Buffer;
+	int ret, Produced, Size, Max;
+
+	if (!LZMAHeaderParse(PackedBuffer, PackedBufferSize, &original_size,
+			     &dictionary_size))
+		return -1;
+
+	if (original_size == LZMA_SIZE_UNKNOWN) {
+		Size = (MaxSize < 0x10000) ? MaxSize : 0x10000;
+		Max = MaxSize;
+	} else {
+		if (original_size > MaxSize)
+			return -1;
+		Size = Max = original_size;
+	}
+
+	Buffer = malloc(Size ? Size : 1);
+	if (!Buffer) {
+		fprintf(stderr, "Error: Out of memory for %d bytes of LZMA "
+			"data\n", Size);
+		return -1;
+	}
+
+	ret = LZMADecodeStream(PackedBuffer, PackedBufferSize, &Buffer, &Size,
+			       Max, original_size == LZMA_SIZE_UNKNOWN,
+			       &Produced);
+	if ((ret < 0) || ((original_size != LZMA_SIZE_UNKNOWN) &&
+			  (Produced != original_size))) {
+		free(Buffer);
+		return -1;
+	}
+
+	*OutputBuffer = Buffer;
+	*OutputBufferSize = Produced;
+	return ret;
+}
+
+/*
+ * Returns the size of the expanded data of a stream, or -1. Streams of
+ * unknown length have to be decoded up to their end marker for this, into
+ * OutputBuffer, which bounds the size. With a NULL OutputBuffer, they are
+ * decoded into a buffer which grows up to the largest size we believe in.
+ */
+int
+LZMAExpandedSize(unsigned char *PackedBuffer, int PackedBufferSize,
+		 unsigned char *OutputBuffer, int OutputBufferSize)
+{
+	unsigned int original_size, dictionary_size;
+	unsigned char *Buffer;
+	int Produced;
+
+	if (!LZMAHeaderParse(PackedBuffer, PackedBufferSize, &original_size,
+			     &dictionary_size))
+		return -1;
+
+	if (original_size != LZMA_SIZE_UNKNOWN)
+		return original_size;
+
+	if (OutputBuffer) {
+		if (LZMADecodeStream(PackedBuffer, PackedBufferSize,
+				     &OutputBuffer, &OutputBufferSize,
+				     OutputBufferSize, TRUE, &Produced) < 0)
+			return -1;
+		return Produced;
+	}
+
+	if (LZMADecodeAlloc(PackedBuffer, PackedBufferSize, &Buffer, &Produced,
+			    LZMA_SIZE_MAX) < 0)
+		return -1;
+
+	free(Buffer);
+	return Produced;
+}
+
+/*
+ * LZMA encoders only write dictionary sizes of 2^n or 2^n + 2^(n-1).
+ */
+static Bool LZMADictionaryValid(unsigned int Size)
+{
+	unsigned int Low = Size & -Size;
+
+	if (Size < 0x1000)
+		return FALSE;
+	return (Size == Low) || (Size == (Low * 3));
+}
+
+/*
+ * Find the next plausible LZMA stream at or after Offset, or -1. Practically
+ * every encoder uses the default lc=3 lp=0 pb=2 properties, so this only
+ * looks for 0x5D bytes, which memchr finds a machine word or vector at a
+ * time.
+ */
+int LZMAScan(unsigned char *Buffer, int BufferSize, int Offset)
+{
+	unsigned int original_size, dictionary_size;
+	unsigned char *p;
+
+	while (Offset <= (BufferSize - LZMA_HEADER_SIZE - 5)) {
+		p = memchr(Buffer + Offset, 0x5D,
+			   BufferSize - LZMA_HEADER_SIZE - 5 - Offset + 1);
+		if (!p)
+			break;
+		Offset = p - Buffer;
+
+		if (LZMAHeaderParse(p, BufferSize - Offset, &original_size,
+				    &dictionary_size) && original_size &&
+		    LZMADictionaryValid(dictionary_size) &&
+		    !p[LZMA_HEADER_SIZE])
+			return Offset;
+
+		Offset++;
+	}
+
+	return -1;
+}
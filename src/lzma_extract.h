@@ -0,0 +1,42 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef LZMA_EXTRACT_H
+#define LZMA_EXTRACT_H
+
+/* 5 bytes of properties, followed by the 64bit uncompressed size */
+#define LZMA_HEADER_SIZE 13
+
+/* streams which end with an end marker instead */
+#define LZMA_SIZE_UNKNOWN 0xFFFFFFFF
+
+int LZMAHeaderParse(unsigned char *Buffer, int BufferSize,
+		    unsigned int *original_size,
+		    unsigned int *dictionary_size);
+
+int LZMADecode(unsigned char *PackedBuffer, int PackedBufferSize,
+	       unsigned char *OutputBuffer, int OutputBufferSize);
+
+int LZMADecodeAlloc(unsigned char *PackedBuffer, int PackedBufferSize,
+		    unsigned char **OutputBuffer, int *OutputBufferSize,
+		    int MaxSize);
+
+int LZMAExpandedSize(unsigned char *PackedBuffer, int PackedBufferSize,
+		     unsigned char *OutputBuffer, int OutputBufferSize);
+
+int LZMAScan(unsigned char *Buffer, int BufferSize, int Offset);
+
+#endif				/* LZMA_EXTRACT_H */
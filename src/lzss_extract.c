@@ -16,77 +16,84 @@
  * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+/*
+ * Okumura style LZSS with a 4kB window: a flag byte tells for each of the
+ * following 8 items whether it is a literal (1) or a 12bit position with a
+ * 4bit length (0). Positions are absolute in the ring buffer, which starts
+ * out being filled in at 0x1000 - the longest match.
+ */
+
 #include <stdio.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <errno.h>
 #include <string.h>
 
 #include "lzss_extract.h"
 
-static inline int
-LZSSBufferWrite(int fd, unsigned char *Buffer, int *BufferCount,
-		unsigned char value)
-{
-	Buffer[*BufferCount] = value;
-	*BufferCount += 1;
-
-	if (*BufferCount == 0x1000) {
-		if (write(fd, Buffer, 0x1000) != 0x1000) {
-			fprintf(stderr, "Error writing to output file: %s",
-				strerror(errno));
-			return 1;
-		}
-		*BufferCount = 0;
-	}
+#define LZSS_N 0x1000
 
-	return 0;
-}
-
-int LZSSExtract(unsigned char *Input, int InputSize, int fd)
+/*
+ * Decodes until either the input or the output runs out, and returns the
+ * number of bytes produced. With a NULL OutputBuffer, nothing is written,
+ * which tells the size of streams that do not store it. The window starts
+ * out filled with Fill, and matches are longer than Threshold.
+ */
+int
+LZSSDecode(unsigned char *Input, int InputSize, unsigned char *OutputBuffer,
+	   int OutputBufferSize, unsigned char Fill, int Threshold)
 {
-	unsigned char Buffer[0x1000];
-	unsigned short BitBuffer = 0;
-	int i = 0, k, BitCount = 8, BufferCount = 0;
+	int Start = LZSS_N - (0x0F + Threshold + 1);
+	int i = 0, k, Offset = 0, Source, Length, Distance;
+	unsigned char Flags = 0;
+	int FlagCount = 0;
 
-	while (i < InputSize) {
+	if (!OutputBuffer)
+		OutputBufferSize = 0x7FFFFFFF;
 
-		if (BitCount == 8) {
-			BitBuffer = Input[i];
-			BitCount = -1;
-		} else if ((BitBuffer >> BitCount) & 0x01) {
-			if (LZSSBufferWrite(fd, Buffer, &BufferCount, Input[i]))
-				return 1;
-		} else if ((i + 1) < InputSize) {
-			int offset =
-			    ((Input[i] | ((Input[i + 1] & 0xF0) << 4)) -
-			     0xFEE) & 0xFFF;
-			int length = (Input[i + 1] & 0x0F) + 3;
+	while ((i < InputSize) && (Offset < OutputBufferSize)) {
+		if (!FlagCount) {
+			Flags = Input[i++];
+			FlagCount = 8;
+			continue;
+		}
 
-			for (k = 0; k < length; k++) {
-				if (LZSSBufferWrite
-				    (fd, Buffer, &BufferCount,
-				     Buffer[(offset + k) & 0xFFF]))
-					return 1;
-			}
+		if (Flags & 0x01) {
+			if (OutputBuffer)
+				OutputBuffer[Offset] = Input[i];
+			Offset++;
 			i++;
 		} else {
-			fprintf(stderr,
-				"Error: requesting data beyond end of input file.\n");
-			return 1;
-		}
+			if ((i + 1) >= InputSize) {
+				fprintf(stderr, "Error: requesting data beyond "
+					"end of LZSS input.\n");
+				return -1;
+			}
 
-		i++;
-		BitCount++;
-	}
+			Source = Input[i] | ((Input[i + 1] & 0xF0) << 4);
+			Length = (Input[i + 1] & 0x0F) + Threshold + 1;
+			i += 2;
+
+			/* distance back from the current ring position */
+			Distance = (Start + Offset - Source) & (LZSS_N - 1);
+			if (!Distance)
+				Distance = LZSS_N;
 
-	if (BufferCount) {
-		if (write(fd, Buffer, BufferCount) != BufferCount) {
-			fprintf(stderr, "Error writing to output file: %s",
-				strerror(errno));
-			return 1;
+			if (Length > (OutputBufferSize - Offset))
+				Length = OutputBufferSize - Offset;
+
+			if (OutputBuffer) {
+				for (k = 0; k < Length; k++, Offset++) {
+					if (Offset < Distance)
+						OutputBuffer[Offset] = Fill;
+					else
+						OutputBuffer[Offset] =
+						    OutputBuffer[Offset - Distance];
+				}
+			} else
+				Offset += Length;
 		}
+
+		Flags >>= 1;
+		FlagCount--;
 	}
 
-	return 0;
+	return Offset;
 }
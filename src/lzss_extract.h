@@ -19,6 +19,11 @@
 #ifndef LZSS_EXTRACT_H
 #define LZSS_EXTRACT_H
 
-int LZSSExtract(unsigned char *Input, int InputSize, int fd);
+/* as in Okumura's LZSS.C, which BCPVPD and $COMPIBM images use */
+#define LZSS_FILL	' '
+#define LZSS_THRESHOLD	2
+
+int LZSSDecode(unsigned char *Input, int InputSize, unsigned char *OutputBuffer,
+	       int OutputBufferSize, unsigned char Fill, int Threshold);
 
 #endif				/* LZSS_EXTRACT_H */
@@ -0,0 +1,145 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * The manifest is a plain text file with one tab separated record per
+ * line. The first field names the record type, fields which do not apply
+ * are written as "-":
+ *
+ *   module <type> <id> <offset> <packed> <expanded> <codec> <name> <guid> <file>
+ *	A module as found in the image. <offset> is that of the packed data.
+ *
+ *   extent <file> <offset> <length> <fill>
+ *	A run of <fill> bytes which was not stored in <file>.
+ *
+ *   microcode <file> <offset> <size> <vendor> <signature> <revision> <date> <flags>
+ *	A microcode update found in the input image or in a decoded <file>.
+ *	<flags> are the platform ids the update applies to.
+ *
+ *   artifact <file> <offset> <size> <type> <version> <id>
+ *	A firmware table found in the input image or in a decoded <file>:
+ *	rsdp, dsdt, facp, ssdt, apic, smbios, smbios3, pir or mp. <id> is
+ *	the OEM id and OEM table id for ACPI.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+
+#include "bios_extract.h"
+
+static FILE *Manifest;
+
+Bool ManifestOpen(char *filename)
+{
+	Manifest = fopen(filename, "w");
+	if (!Manifest) {
+		fprintf(stderr, "Error: unable to open %s: %s\n", filename,
+			strerror(errno));
+		return FALSE;
+	}
+
+	fprintf(Manifest, "# bios_extract manifest\n");
+	return TRUE;
+}
+
+void ManifestClose(void)
+{
+	if (Manifest)
+		fclose(Manifest);
+	Manifest = NULL;
+}
+
+Bool ManifestActive(void)
+{
+	return Manifest != NULL;
+}
+
+static char *ManifestString(char *String)
+{
+	if (!String || !String[0])
+		return "-";
+	return String;
+}
+
+void ManifestModule(struct ModuleInfo *Module)
+{
+	char Id[12], *Directory, *File = Module->File;
+
+	if (!Manifest)
+		return;
+
+	/* nested modules are written below their container */
+	Directory = OutputDirectoryGet();
+	if (File && Directory) {
+		File = malloc(strlen(Directory) + strlen(Module->File) + 2);
+		if (File)
+			sprintf(File, "%s/%s", Directory, Module->File);
+	}
+
+	if (Module->Id < 0)
+		strcpy(Id, "-");
+	else
+		snprintf(Id, sizeof(Id), "0x%02X", Module->Id);
+
+	fprintf(Manifest,
+		"module\t%s\t%s\t0x%08X\t0x%08X\t0x%08X\t%s\t%s\t%s\t%s\n",
+		ManifestString(Module->Type), Id, Module->Offset,
+		Module->PackedSize, Module->ExpandedSize,
+		ManifestString(Module->Codec), ManifestString(Module->Name),
+		ManifestString(Module->Guid), ManifestString(File));
+
+	if (File != Module->File)
+		free(File);
+}
+
+void
+ManifestExtent(char *filename, uint32_t Offset, uint32_t Length, uint8_t Fill)
+{
+	if (!Manifest)
+		return;
+
+	fprintf(Manifest, "extent\t%s\t0x%08X\t0x%08X\t0x%02X\n", filename,
+		Offset, Length, Fill);
+}
+
+void
+ManifestMicrocode(char *filename, uint32_t Offset, uint32_t Size, char *Vendor,
+		  uint32_t Signature, uint32_t Revision, char *Date,
+		  uint32_t Flags)
+{
+	if (!Manifest)
+		return;
+
+	fprintf(Manifest,
+		"microcode\t%s\t0x%08X\t0x%08X\t%s\t0x%08X\t0x%08X\t%s\t0x%02X\n",
+		filename, Offset, Size, Vendor, Signature, Revision, Date,
+		Flags);
+}
+
+void
+ManifestArtifact(char *filename, uint32_t Offset, uint32_t Size, char *Type,
+		 char *Version, char *Id)
+{
+	if (!Manifest)
+		return;
+
+	fprintf(Manifest, "artifact\t%s\t0x%08X\t0x%08X\t%s\t%s\t%s\n",
+		filename, Offset, Size, Type, ManifestString(Version),
+		ManifestString(Id));
+}
@@ -0,0 +1,166 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Intel and VIA microcode updates. Both start with a 48 byte header with
+ * the same layout, and the 32bit words of the whole update add up to 0.
+ * Updates have to be 16 byte aligned to be loaded, so they are only
+ * looked for at 4 byte aligned offsets, which keeps the header search to
+ * a vectorized compare of the first word.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "scan.h"
+
+struct MicrocodeHeader {
+	uint32_t HeaderVersion;	/* VIA: "RRAS" */
+	uint32_t UpdateRevision;
+	uint32_t Date;		/* mmddyyyy, BCD on Intel */
+	uint32_t ProcessorSignature;
+	uint32_t Checksum;
+	uint32_t LoaderRevision;
+	uint32_t ProcessorFlags;
+	uint32_t DataSize;	/* 0: 2048 bytes in total */
+	uint32_t TotalSize;
+	uint32_t Reserved[3];
+};
+
+#define MICROCODE_DEFAULT_SIZE	2048
+
+static struct MicrocodeVendor {
+	char *Name;
+	uint32_t Magic;
+	Bool BCD;
+	uint32_t SizeAlign;
+} MicrocodeVendors[] = {
+	{"intel", 0x00000001, TRUE, 1024},
+	{"via", 0x53415252, FALSE, 4},
+	{NULL, 0, FALSE, 0}
+};
+
+static Bool MicrocodeDateCheck(uint32_t Date, Bool BCD, char *String)
+{
+	int Month = Date >> 24, Day = (Date >> 16) & 0xFF, Year = Date & 0xFFFF;
+
+	if (BCD) {
+		if (((Month & 0x0F) > 9) || ((Day & 0x0F) > 9) ||
+		    ((Year & 0x0F) > 9) || (((Year >> 4) & 0x0F) > 9) ||
+		    (((Year >> 8) & 0x0F) > 9) || ((Year >> 12) > 9))
+			return FALSE;
+		Month = (Month >> 4) * 10 + (Month & 0x0F);
+		Day = (Day >> 4) * 10 + (Day & 0x0F);
+		Year = (Year >> 12) * 1000 + ((Year >> 8) & 0x0F) * 100 +
+		    ((Year >> 4) & 0x0F) * 10 + (Year & 0x0F);
+	}
+
+	if ((Month < 1) || (Month > 12) || (Day < 1) || (Day > 31) ||
+	    (Year < 1990) || (Year > 2099))
+		return FALSE;
+
+	sprintf(String, "%04d-%02d-%02d", Year, Month, Day);
+	return TRUE;
+}
+
+/*
+ * Returns the size of the update at the start of Buffer, or 0.
+ */
+static uint32_t
+MicrocodeCheck(unsigned char *Buffer, int Length,
+	       struct MicrocodeVendor *Vendor, char *Date)
+{
+	struct MicrocodeHeader *Header = (struct MicrocodeHeader *)Buffer;
+	uint32_t DataSize, TotalSize, Size;
+
+	if (Length < sizeof(struct MicrocodeHeader))
+		return 0;
+
+	DataSize = le32toh(Header->DataSize);
+	TotalSize = le32toh(Header->TotalSize);
+
+	if (DataSize) {
+		if ((TotalSize < MICROCODE_DEFAULT_SIZE) ||
+		    (TotalSize % Vendor->SizeAlign) || (DataSize & 3) ||
+		    (DataSize > (TotalSize - sizeof(struct MicrocodeHeader))))
+			return 0;
+		Size = TotalSize;
+	} else
+		Size = MICROCODE_DEFAULT_SIZE;
+
+	if (Size > Length)
+		return 0;
+
+	/* Intel has only ever had loader revision 1 */
+	if (Vendor->BCD && (le32toh(Header->LoaderRevision) != 1))
+		return 0;
+
+	if (!MicrocodeDateCheck(le32toh(Header->Date), Vendor->BCD, Date))
+		return 0;
+
+	if (ScanSum32(Buffer, Size))
+		return 0;
+
+	return Size;
+}
+
+/*
+ * Record the microcode updates in Buffer, which holds filename, in the
+ * manifest. Returns the number of updates found.
+ */
+int MicrocodeScan(unsigned char *Buffer, int Length, char *filename)
+{
+	struct MicrocodeVendor *Vendor;
+	struct MicrocodeHeader *Header;
+	uint32_t Size;
+	int Offset, Found, Count = 0;
+	char Date[16];
+
+	if (!ManifestActive())
+		return 0;
+
+	for (Vendor = MicrocodeVendors; Vendor->Name; Vendor++) {
+		Offset = 0;
+		while (Offset < Length) {
+			Found = ScanFind32(Buffer + Offset, Length - Offset,
+					   Vendor->Magic);
+			if (Found < 0)
+				break;
+			Offset += Found;
+
+			Size = MicrocodeCheck(Buffer + Offset, Length - Offset,
+					      Vendor, Date);
+			if (!Size) {
+				Offset += 4;
+				continue;
+			}
+
+			Header = (struct MicrocodeHeader *)(Buffer + Offset);
+			ManifestMicrocode(filename, Offset, Size, Vendor->Name,
+					  le32toh(Header->ProcessorSignature),
+					  le32toh(Header->UpdateRevision), Date,
+					  le32toh(Header->ProcessorFlags));
+			Count++;
+
+			Offset += Size;
+		}
+	}
+
+	return Count;
+}
@@ -0,0 +1,374 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Output files. Decoders either hand over a complete buffer, or get a
+ * buffer handed out that they fill in directly. Every finished output is
+ * scanned for microcode and firmware tables while it is still in memory,
+ * and passed on to the output hook, which is how recursive extraction
+ * gets to see the decoded data without reading it back from disk.
+ *
+ * Outputs which are plain slices of the container being extracted are
+ * neither, that data has been scanned already and there is nothing new to
+ * be found in it. The boot block of an AMI95 image would otherwise also
+ * identify as the image itself.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "scan.h"
+
+/*
+ * Output files which are still being filled in by a decoder.
+ */
+struct OutputFile {
+	unsigned char *Buffer;
+	char *Name;
+	struct OutputFile *Next;
+};
+
+static struct OutputFile *OutputFiles;
+static pthread_mutex_t OutputFilesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Where nested outputs go, set per thread while a container is extracted. */
+static __thread char *OutputDirectory;
+static __thread unsigned char *OutputContainer;
+static __thread int OutputContainerLength;
+
+static void (*OutputHook) (char *filename, unsigned char *Buffer, int size);
+
+void OutputDirectorySet(char *Directory)
+{
+	OutputDirectory = Directory;
+}
+
+char *OutputDirectoryGet(void)
+{
+	return OutputDirectory;
+}
+
+void OutputContainerSet(unsigned char *Buffer, int Length)
+{
+	OutputContainer = Buffer;
+	OutputContainerLength = Length;
+}
+
+void OutputHookSet(void (*Hook) (char *filename, unsigned char *Buffer,
+				 int size))
+{
+	OutputHook = Hook;
+}
+
+/*
+ * Returns the path to write filename to, which has to be freed.
+ */
+static char *OutputFileName(char *filename)
+{
+	char *tmp;
+
+	/* all slash signs '/' in filenames will be replaced by a backslash sign '\' */
+	tmp = filename;
+	while ((tmp = strchr(tmp, '/')) != NULL)
+		tmp[0] = '\\';
+
+	if (!OutputDirectory)
+		return strdup(filename);
+
+	if (mkdir(OutputDirectory, S_IRWXU) && (errno != EEXIST)) {
+		fprintf(stderr, "Error: unable to create %s: %s\n",
+			OutputDirectory, strerror(errno));
+		return NULL;
+	}
+
+	tmp = malloc(strlen(OutputDirectory) + strlen(filename) + 2);
+	if (tmp)
+		sprintf(tmp, "%s/%s", OutputDirectory, filename);
+	return tmp;
+}
+
+static int OutputFileOpen(char *filename)
+{
+	int fd;
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		fprintf(stderr, "Error: unable to open %s: %s\n\n", filename,
+			strerror(errno));
+
+	return fd;
+}
+
+static Bool
+OutputFileWrite(int fd, char *filename, unsigned char *Buffer, int size,
+		off_t Offset)
+{
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = pwrite(fd, Buffer, size, Offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Error: Failed to write to \"%s\": %s\n",
+				filename, strerror(errno));
+			return FALSE;
+		}
+		Buffer += ret;
+		size -= ret;
+		Offset += ret;
+	}
+
+	return TRUE;
+}
+
+#define OUTPUT_BLOCK_SIZE 0x1000
+
+enum OutputBlockType {
+	OUTPUT_BLOCK_DATA,
+	OUTPUT_BLOCK_HOLE,
+	OUTPUT_BLOCK_FILL,
+};
+
+/*
+ * Only write out the blocks that hold data. Blocks of 0x00 become holes,
+ * blocks of 0xFF are left as holes as well when there is a manifest to
+ * record them in.
+ */
+static Bool
+OutputFileWriteSparse(int fd, char *filename, unsigned char *Buffer, int size)
+{
+	enum OutputBlockType Type, RunType = OUTPUT_BLOCK_HOLE;
+	int Offset, Length, RunStart = 0;
+
+	for (Offset = 0; Offset <= size; Offset += Length) {
+		Length = size - Offset;
+		if (Length > OUTPUT_BLOCK_SIZE)
+			Length = OUTPUT_BLOCK_SIZE;
+
+		if (!Length)
+			Type = OUTPUT_BLOCK_HOLE;	/* flush the last run */
+		else if (ScanRunLength(Buffer + Offset, Length, 0x00) == Length)
+			Type = OUTPUT_BLOCK_HOLE;
+		else if (ManifestActive() &&
+			 (ScanRunLength(Buffer + Offset, Length, 0xFF) == Length))
+			Type = OUTPUT_BLOCK_FILL;
+		else
+			Type = OUTPUT_BLOCK_DATA;
+
+		if ((Type != RunType) || !Length) {
+			if (RunType == OUTPUT_BLOCK_DATA) {
+				if (!OutputFileWrite(fd, filename,
+						     Buffer + RunStart,
+						     Offset - RunStart, RunStart))
+					return FALSE;
+			} else if ((RunType == OUTPUT_BLOCK_FILL)
+				   && (Offset > RunStart))
+				ManifestExtent(filename, RunStart,
+					       Offset - RunStart, 0xFF);
+
+			RunType = Type;
+			RunStart = Offset;
+		}
+
+		if (!Length)
+			break;
+	}
+
+	if (ftruncate(fd, size)) {
+		fprintf(stderr, "Error: Failed to grow \"%s\": %s\n", filename,
+			strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static Bool OutputFileStore(char *Path, unsigned char *Buffer, int size)
+{
+	Bool ret;
+	int fd;
+
+	fd = OutputFileOpen(Path);
+	if (fd < 0)
+		return FALSE;
+
+	if (Options.Sparse)
+		ret = OutputFileWriteSparse(fd, Path, Buffer, size);
+	else
+		ret = OutputFileWrite(fd, Path, Buffer, size, 0);
+
+	close(fd);
+
+	return ret;
+}
+
+static void OutputFileDone(char *Path, unsigned char *Buffer, int size)
+{
+	if ((Buffer >= OutputContainer)
+	    && (Buffer < (OutputContainer + OutputContainerLength)))
+		return;
+
+	MicrocodeScan(Buffer, size, Path);
+	ArtifactScan(Buffer, size, Path);
+
+	if (OutputHook)
+		OutputHook(Path, Buffer, size);
+}
+
+/*
+ * Write out a whole buffer in one go.
+ */
+Bool WriteOutputFile(char *filename, unsigned char *Buffer, int size)
+{
+	char *Path;
+	Bool ret;
+
+	Path = OutputFileName(filename);
+	if (!Path)
+		return FALSE;
+
+	ret = OutputFileStore(Path, Buffer, size);
+	if (ret)
+		OutputFileDone(Path, Buffer, size);
+
+	free(Path);
+	return ret;
+}
+
+/*
+ * Hand out a buffer for a decoder to fill in. It has to be released with
+ * CloseOutputFile(). When writing sparse files, this is anonymous memory
+ * which only gets written out when it is released, so that runs of 0x00
+ * never turn into allocated blocks or dirty page cache.
+ */
+unsigned char *MMapOutputFile(char *filename, int size)
+{
+	struct OutputFile *File;
+	unsigned char *Buffer;
+	char *Path;
+	int fd;
+
+	Path = OutputFileName(filename);
+	if (!Path)
+		return NULL;
+
+	if (Options.Sparse) {
+		Buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (Buffer == ((void *)-1)) {
+			fprintf(stderr, "Error: Failed to allocate %d bytes for"
+				" %s: %s\n", size, Path, strerror(errno));
+			free(Path);
+			return NULL;
+		}
+	} else {
+		fd = OutputFileOpen(Path);
+		if (fd < 0) {
+			free(Path);
+			return NULL;
+		}
+
+		/* grow file */
+		if (lseek(fd, size - 1, SEEK_SET) == -1) {
+			fprintf(stderr, "Error: Failed to grow \"%s\": %s\n",
+				Path, strerror(errno));
+			close(fd);
+			free(Path);
+			return NULL;
+		}
+
+		if (write(fd, "", 1) != 1) {
+			fprintf(stderr, "Error: Failed to write to \"%s\": %s\n",
+				Path, strerror(errno));
+			close(fd);
+			free(Path);
+			return NULL;
+		}
+
+		Buffer =
+		    mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (Buffer == ((void *)-1)) {
+			fprintf(stderr, "Error: Failed to mmap %s: %s\n",
+				Path, strerror(errno));
+			close(fd);
+			free(Path);
+			return NULL;
+		}
+
+		close(fd);
+	}
+
+	File = malloc(sizeof(struct OutputFile));
+	if (!File) {
+		fprintf(stderr, "Error: Out of memory for %s\n", Path);
+		munmap(Buffer, size);
+		free(Path);
+		return NULL;
+	}
+	File->Buffer = Buffer;
+	File->Name = Path;
+
+	pthread_mutex_lock(&OutputFilesLock);
+	File->Next = OutputFiles;
+	OutputFiles = File;
+	pthread_mutex_unlock(&OutputFilesLock);
+
+	return Buffer;
+}
+
+void CloseOutputFile(unsigned char *Buffer, int size)
+{
+	struct OutputFile *File, *Prev = NULL;
+	Bool ret = TRUE;
+
+	pthread_mutex_lock(&OutputFilesLock);
+	for (File = OutputFiles; File; Prev = File, File = File->Next)
+		if (File->Buffer == Buffer)
+			break;
+
+	if (File) {
+		if (Prev)
+			Prev->Next = File->Next;
+		else
+			OutputFiles = File->Next;
+	}
+	pthread_mutex_unlock(&OutputFilesLock);
+
+	if (File) {
+		if (Options.Sparse)
+			ret = OutputFileStore(File->Name, Buffer, size);
+
+		if (ret)
+			OutputFileDone(File->Name, Buffer, size);
+
+		free(File->Name);
+		free(File);
+	}
+
+	munmap(Buffer, size);
+}
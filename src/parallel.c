@@ -0,0 +1,113 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Running independent pieces of work, like decoding a batch of streams, on
+ * as many threads as there are jobs allowed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "compat.h"
+#include "bios_extract.h"
+
+struct ParallelBatch {
+	int Count;
+	int Next;		/* the next item to hand out */
+	pthread_mutex_t Lock;
+	void (*Work) (void *Private, int Index);
+	void *Private;
+};
+
+/*
+ * The number of threads to use, one per CPU unless --jobs says otherwise.
+ */
+int ParallelJobs(void)
+{
+	int Jobs = Options.Jobs;
+
+	if (Jobs < 1)
+		Jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (Jobs < 1)
+		Jobs = 1;
+
+	return Jobs;
+}
+
+static void *ParallelWorker(void *Private)
+{
+	struct ParallelBatch *Batch = Private;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&Batch->Lock);
+		i = Batch->Next++;
+		pthread_mutex_unlock(&Batch->Lock);
+
+		if (i >= Batch->Count)
+			break;
+
+		Batch->Work(Batch->Private, i);
+	}
+
+	return NULL;
+}
+
+/*
+ * Call Work for every Index below Count, spread over the worker threads,
+ * and return once all of them are done. In which order and on which
+ * thread is not defined.
+ */
+void ParallelRun(int Count, void (*Work) (void *Private, int Index),
+		 void *Private)
+{
+	struct ParallelBatch Batch;
+	pthread_t *Threads;
+	int i, Jobs = ParallelJobs();
+
+	if (Count < 1)
+		return;
+	if (Jobs > Count)
+		Jobs = Count;
+
+	Batch.Count = Count;
+	Batch.Next = 0;
+	pthread_mutex_init(&Batch.Lock, NULL);
+	Batch.Work = Work;
+	Batch.Private = Private;
+
+	Threads = calloc(Jobs, sizeof(pthread_t));
+	if (!Threads)
+		Jobs = 0;
+
+	for (i = 0; i < Jobs; i++)
+		if (pthread_create(&Threads[i], NULL, ParallelWorker, &Batch))
+			break;
+
+	/* work along when no thread could be started at all */
+	if (!i)
+		ParallelWorker(&Batch);
+
+	while (i--)
+		pthread_join(Threads[i], NULL);
+
+	free(Threads);
+	pthread_mutex_destroy(&Batch.Lock);
+}
@@ -28,7 +28,9 @@
 
 #include "compat.h"
 #include "bios_extract.h"
-#include "lh5_extract.h"
+#include "efi_extract.h"
+#include "lzss_extract.h"
+#include "codec.h"
 
 struct bcpHeader {
 	char signature[6];
@@ -42,9 +44,11 @@ struct Phoenix {
 	uint8_t version;
 	uint8_t type;
 	uint8_t compression;
+	uint8_t lzss_fill;	/* initial content of the LZSS window */
 };
 
-static struct Phoenix phx = { 0, 0, 0 };
+/* per thread, as nested images get extracted in parallel */
+static __thread struct Phoenix phx = { 0, 0, 0, LZSS_FILL };
 
 #define COMP_LZSS 0
 #define COMP_LZARI 1
@@ -235,6 +239,23 @@ struct PhoenixFFVCompressionHeader {
 	uint8_t Unk3;
 };
 
+/*
+ * Returns the codec id, or -1.
+ */
+static int PhoenixModuleCodecGet(uint8_t Compression)
+{
+	switch (Compression) {
+	case 0:
+		return CODEC_STORED;
+	case 3:
+		return CODEC_LZSS;
+	case 5:
+		return CODEC_LH5;
+	default:
+		return -1;
+	}
+}
+
 static char *PhoenixModuleNameGet(char Id)
 {
 	int i;
@@ -245,24 +266,114 @@ static char *PhoenixModuleNameGet(char Id)
 	return NULL;
 }
 
-static void
-phx_write_file(unsigned char *BIOSImage, char *filename, short filetype,
-	       int offset, uint32_t length)
+/*
+ * Sections which are not LH5 compressed might carry the 8 byte header of
+ * EFI compression instead.
+ */
+static Bool
+PhoenixFFVEFICheck(unsigned char *Packed, int PackedLen, uint32_t RealLen)
+{
+	unsigned int OriginalSize, PackedSize;
+
+	if ((phx.compression == COMP_LZHUF) || (phx.compression == COMP_LZINT))
+		return FALSE;
+
+	if (!EFIHeaderParse(Packed, PackedLen, &OriginalSize, &PackedSize))
+		return FALSE;
+
+	return OriginalSize == RealLen;
+}
+
+/*
+ * Returns the codec id, or -1. EFI 1.1 and Tiano streams share their
+ * header, the version is told from the first block.
+ */
+static int
+PhoenixFFVCodecGet(unsigned char *Packed, int PackedLen, uint32_t RealLen)
 {
-	int fd;
+	if (PhoenixFFVEFICheck(Packed, PackedLen, RealLen))
+		return CODEC_EFI;
+
+	switch (phx.compression) {
+	case COMP_LZSS:
+		return CODEC_LZSS;
+	case COMP_LZARI:
+		return CODEC_LZARI;
+	case COMP_LZHUF:
+		return CODEC_LH5;
+	case COMP_LZINT:
+		return CODEC_LZINT;
+	default:
+		return -1;
+	}
+}
+
+static int PhoenixCodecParameter(int Codec)
+{
+	if (Codec == CODEC_LZSS)
+		return phx.lzss_fill;
+	return CODEC_PARAMETER_DEFAULT;
+}
+
+static int
+PhoenixFFVDecode(unsigned char *Packed, int PackedLen, unsigned char *Real,
+		 uint32_t RealLen)
+{
+	int Codec = PhoenixFFVCodecGet(Packed, PackedLen, RealLen);
+
+	if (Codec == -1) {
+		fprintf(stderr, "Unsupported compression!\n");
+		return -1;
+	}
 
+	/* the packed and real lengths of the compression header are the
+	 * LZINT header */
+	if (Codec == CODEC_LZINT) {
+		Packed -= 8;
+		PackedLen += 8;
+	}
+
+	return CodecDecode(Codec, Packed, PackedLen, Real, RealLen,
+			   PhoenixCodecParameter(Codec));
+}
+
+static void
+phx_file_name(char *filename, short filetype, int offset, uint32_t length)
+{
 	if (filename[0] == '\0') {
 		sprintf(filename, "%s_0x%08x-0x%08x", get_file_type(filetype),
 			offset, offset + length);
 	}
-	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (fd < 0) {
-		fprintf(stderr, "Error: unable to open %s: %s\n\n", filename,
-			strerror(errno));
-		return;
-	}
-	write(fd, BIOSImage + offset + 0x18, length - 0x18);
-	close(fd);
+}
+
+static void
+phx_write_file(unsigned char *BIOSImage, char *filename, short filetype,
+	       int offset, uint32_t length)
+{
+	phx_file_name(filename, filetype, offset, length);
+	WriteOutputFile(filename, BIOSImage + offset + 0x18, length - 0x18);
+}
+
+/*
+ * Raw areas of the volume directory are stored as they are.
+ */
+static void
+phx_write_raw(unsigned char *BIOSImage, char *filename, char *name,
+	      char *guid, uint32_t base, uint32_t length)
+{
+	struct ModuleInfo Info;
+
+	Info.Offset = base;
+	Info.PackedSize = length;
+	Info.ExpandedSize = length;
+	Info.Id = -1;
+	Info.Type = "volume";
+	Info.Codec = CodecName(CODEC_STORED);
+	Info.Name = name;
+	Info.Guid = guid;
+	Info.File = filename;
+	if (ModuleWanted(&Info))
+		WriteOutputFile(filename, BIOSImage + base, length);
 }
 
 /* ---------- Extraction code ---------- */
@@ -283,11 +394,13 @@ static int PhoenixModule(unsigned char *BIOSImage, int BIOSLength, int Offset)
 		uint32_t NextFrag;
 	} *Module;
 
+	struct ModuleInfo Info;
+	Bool Extract;
 	char *filename, *ModuleName;
 	unsigned char *Buffer;
 	unsigned char *ModuleData;
 	uint32_t Packed;
-	int fd;
+	int Codec, Skip;
 
 	Module = (struct PhoenixModule *)(BIOSImage + Offset);
 
@@ -375,50 +488,58 @@ static int PhoenixModule(unsigned char *BIOSImage, int BIOSLength, int Offset)
 		sprintf(filename, "%02X_%1d.rom", Module->Type, Module->Id);
 	}
 
-	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (fd < 0) {
-		fprintf(stderr, "Error: unable to open %s: %s\n\n", filename,
-			strerror(errno));
-		free(filename);
-		if ((le32toh(Module->NextFrag) & 0xF0000000) == 0xF0000000)
-			free(ModuleData);
-		return le32toh(Module->Previous);
-	}
-
-	switch (Module->Compression) {
-	case 5:		/* LH5 */
-		printf("0x%05X (%6d bytes)   ->   %s\t(%d bytes)",
-		       Offset + Module->HeadLen + 4, Packed, filename,
-		       le32toh(Module->ExpLen));
-		Buffer = MMapOutputFile(filename, le32toh(Module->ExpLen));
-		if (!Buffer)
-			break;
-
-		/* The first 4 bytes of the LH5 packing method is just the total
-		 *      expanded length; skip them */
-		LH5Decode(ModuleData + 4, Packed - 4, Buffer,
-			  le32toh(Module->ExpLen));
-		munmap(Buffer, le32toh(Module->ExpLen));
-		break;
-
-		/* case 3 *//* LZSS */
-	case 0:		/* not compressed at all */
+	Info.Offset = Offset + Module->HeadLen;
+	Info.PackedSize = Packed;
+	Info.ExpandedSize = le32toh(Module->ExpLen);
+	Info.Id = Module->Id;
+	Info.Type = "phoenix";
+	Codec = PhoenixModuleCodecGet(Module->Compression);
+	Info.Codec = CodecName(Codec);
+	Info.Name = ModuleName;
+	Info.Guid = NULL;
+	Info.File = filename;
+	if (!Module->Compression)
+		Info.ExpandedSize = Packed;
+	Extract = ModuleWanted(&Info);
+
+	if (Codec == CODEC_STORED) {
 		printf("0x%05X (%6d bytes)   ->   %s", Offset + Module->HeadLen,
 		       Packed, filename);
-		write(fd, ModuleData, Packed);
-		break;
-
-	default:
+		if (Extract)
+			WriteOutputFile(filename, ModuleData, Packed);
+	} else if (Codec == -1) {
 		fprintf(stderr, "Unsupported compression type for %s: %d\n",
 			filename, Module->Compression);
 		printf("0x%05X (%6d bytes)   ->   %s\t(%d bytes)",
 		       Offset + Module->HeadLen, Packed, filename,
 		       le32toh(Module->ExpLen));
-		write(fd, ModuleData, Packed);
-		break;
+		if (Extract)
+			WriteOutputFile(filename, ModuleData, Packed);
+	} else {
+		/* The first 4 bytes of the LH5 packing method is just the total
+		 *      expanded length; skip them */
+		Skip = (Codec == CODEC_LH5) ? 4 : 0;
+
+		printf("0x%05X (%6d bytes)   ->   %s\t(%d bytes)",
+		       Offset + Module->HeadLen + Skip, Packed, filename,
+		       le32toh(Module->ExpLen));
+
+		if (Extract) {
+			Buffer = MMapOutputFile(filename,
+						le32toh(Module->ExpLen));
+			if (Buffer) {
+				if (CodecDecode(Codec, ModuleData + Skip,
+						Packed - Skip, Buffer,
+						le32toh(Module->ExpLen),
+						PhoenixCodecParameter(Codec)))
+					fprintf(stderr, "\nError: Failed to "
+						"decode %s with %s\n", filename,
+						Info.Codec);
+				CloseOutputFile(Buffer, le32toh(Module->ExpLen));
+			}
+		}
 	}
 
-	close(fd);
 	free(filename);
 
 	if ((le32toh(Module->NextFrag) & 0xF0000000) == 0xF0000000)
@@ -441,19 +562,31 @@ PhoenixExtractFFV(unsigned char *BIOSImage, int BIOSLength, int Offset)
 	struct PhoenixFFVSectionHeader *SectionHeader;
 	struct PhoenixFFVCompressionHeader *CompHeader;
 	struct PhoenixFFVModule *Module;
-	char Name[16], filename[24];
+	unsigned char *PackedData;
+	struct ModuleInfo Info;
+	char Name[16], filename[48], guid[37];
 	char *ModuleName;
 	uint32_t Length, PackedLen, RealLen;
 	unsigned char *RealData;
 
 	Module = (struct PhoenixFFVModule *)(BIOSImage + Offset);
 
+	if ((Offset + sizeof(struct PhoenixFFVModule)) > BIOSLength)
+		return 1;
+
 	if (Module->Signature != 0xF8) {
 		/* ignore and move on to the next byte... */
 		return 1;
 	}
 
-	Length = ((le16toh(Module->LengthHi) << 16) | Module->LengthLo) - 1;
+	/* the header is part of the module */
+	Length = (le16toh(Module->LengthHi) << 16) | le16toh(Module->LengthLo);
+	if (Length <= sizeof(struct PhoenixFFVModule)) {
+		fprintf(stderr, "Error: Module too short at 0x%05X\n", Offset);
+		return 1;
+	}
+	Length--;
+
 	if ((Offset + Length) >= BIOSLength) {
 		fprintf(stderr, "Error: Module overruns buffer at 0x%05X\n",
 			Offset);
@@ -492,8 +625,23 @@ PhoenixExtractFFV(unsigned char *BIOSImage, int BIOSLength, int Offset)
 	       Name, Offset, Offset + Length, Length, Module->Flags,
 	       Module->FileType, filename, get_file_type(Module->FileType));
 
+	Info.Offset = Offset + 0x18;
+	Info.PackedSize = Length - 0x18;
+	Info.ExpandedSize = Length - 0x18;
+	Info.Id = Module->FileType;
+	Info.Type = get_file_type(Module->FileType);
+	Info.Codec = CodecName(CODEC_STORED);
+	Info.Name = Name;
+	Info.Guid = NULL;
+	Info.File = NULL;
+	if (!strcmp(Name, "GUID?")) {
+		GuidString(guid, (unsigned char *)Module->Name);
+		Info.Guid = guid;
+	}
+
 	switch (Module->FileType) {
 	case 0xF0:
+		ModuleWanted(&Info);
 		break;
 
 		/* ---------- SECTION file type ---------- */
@@ -502,6 +650,7 @@ PhoenixExtractFFV(unsigned char *BIOSImage, int BIOSLength, int Offset)
 		    (struct PhoenixFFVSectionHeader *)(BIOSImage + Offset +
 						       0x18);
 		if (Name[1] == 'G' || !*filename) {
+			ModuleWanted(&Info);
 			break;
 		}
 
@@ -528,10 +677,23 @@ PhoenixExtractFFV(unsigned char *BIOSImage, int BIOSLength, int Offset)
 			     RealLenHi << 16) | CompHeader->RealLenLo;
 			//printf("CompHeader->Type = %d\n", CompHeader->CompType);
 
-			if (CompHeader->CompType == 0)	/* Not compressed at all */
+			/* Not compressed at all, or FIXME temporary hack */
+			if ((CompHeader->CompType == 0) || !RealLen) {
+				ModuleWanted(&Info);
 				break;
+			}
 
-			if (!RealLen)	/* FIXME temporary hack */
+			PackedData = (unsigned char *)CompHeader +
+			    sizeof(struct PhoenixFFVCompressionHeader);
+
+			Info.Offset = PackedData - BIOSImage;
+			Info.PackedSize = PackedLen;
+			Info.ExpandedSize = RealLen;
+			Info.Codec =
+			    CodecName(PhoenixFFVCodecGet(PackedData, PackedLen,
+							 RealLen));
+			Info.File = filename;
+			if (!ModuleWanted(&Info))
 				break;
 
 			RealData = MMapOutputFile(filename, RealLen);
@@ -540,40 +702,69 @@ PhoenixExtractFFV(unsigned char *BIOSImage, int BIOSLength, int Offset)
 					"Failed to mmap file for uncompressed data.\n");
 				break;
 			}
-			if ((phx.compression == COMP_LZHUF)
-			    || (phx.compression == COMP_LZINT)) {
-				if (LH5Decode
-				    ((unsigned char *)CompHeader +
-				     sizeof(struct PhoenixFFVCompressionHeader),
-				     PackedLen, RealData, RealLen) == -1) {
-					munmap(RealData, RealLen);
-					fprintf(stderr,
-						"Failed to uncompress section with LHA5.\n");
-					/* dump original section in this case */
-					phx_write_file(BIOSImage, filename,
-						       Module->FileType, Offset,
-						       Length);
-				} else
-					printf("COMPRESSED\n");
-			} else
-				printf("Unsupported compression!\n");
-			munmap(RealData, RealLen);
+			if (PhoenixFFVDecode(PackedData, PackedLen, RealData,
+					     RealLen) == -1) {
+				CloseOutputFile(RealData, RealLen);
+				fprintf(stderr,
+					"Failed to uncompress section with %s.\n",
+					Info.Codec);
+				/* dump original section in this case */
+				phx_write_file(BIOSImage, filename,
+					       Module->FileType, Offset,
+					       Length);
+				break;
+			}
+			printf("COMPRESSED\n");
+			CloseOutputFile(RealData, RealLen);
 			break;
 		}
 		printf("\t\tSECTION: %s\n",
 		       get_section_type(SectionHeader->Type));
-		phx_write_file(BIOSImage, filename, Module->FileType, Offset,
-			       Length);
+		Info.File = filename;
+		if (ModuleWanted(&Info))
+			phx_write_file(BIOSImage, filename, Module->FileType,
+				       Offset, Length);
 		break;
 
 	default:
-		phx_write_file(BIOSImage, filename, Module->FileType, Offset,
-			       Length);
+		phx_file_name(filename, Module->FileType, Offset, Length);
+		Info.File = filename;
+		if (ModuleWanted(&Info))
+			phx_write_file(BIOSImage, filename, Module->FileType,
+				       Offset, Length);
 		break;
 	}
 	return Length;
 }
 
+/*
+ * Extract the FFV modules in a volume. Erased and padded space between the
+ * modules can run for megabytes, so rather than trying every byte, skip
+ * straight to the next module signature. memchr() does this a vector at a
+ * time.
+ */
+static void
+PhoenixFFVWalk(unsigned char *BIOSImage, int BIOSLength, uint32_t Base,
+	       uint32_t Length)
+{
+	uint32_t Offset = Base, End = Base + Length, Used;
+	unsigned char *Next;
+
+	if (End > BIOSLength)
+		End = BIOSLength;
+
+	while (Offset < End) {
+		Next = memchr(BIOSImage + Offset, 0xF8, End - Offset);
+		if (!Next)
+			break;
+		Offset = Next - BIOSImage;
+
+		/* always move on, whatever the module claims */
+		Used = PhoenixExtractFFV(BIOSImage, BIOSLength, Offset);
+		Offset += Used ? Used : 1;
+	}
+}
+
 /* Parse initial volumedir layout:
  * - 1 byte Type indicates either raw code or an FFV module
  * - 4 byte Base provides the offset into the image to find the specified volume
@@ -589,7 +780,7 @@ PhoenixVolume1(unsigned char *BIOSImage, int BIOSLength, int Offset, int ModLen)
 	} *Modules;
 
 	char Name[16];
-	int fd, HoleNum = 0;
+	int HoleNum = 0;
 	uint8_t Type;
 	uint32_t Base, Length, NumModules, ModNum;
 
@@ -610,26 +801,13 @@ PhoenixVolume1(unsigned char *BIOSImage, int BIOSLength, int Offset, int ModLen)
 			printf("\tHole (raw code)\n");
 			snprintf(Name, sizeof(Name), "hole_%02x.bin",
 				 HoleNum++);
-			fd = open(Name, O_RDWR | O_CREAT | O_TRUNC,
-				  S_IRUSR | S_IWUSR);
-			if (fd < 0) {
-				fprintf(stderr,
-					"Error: unable to open %s: %s\n\n",
-					Name, strerror(errno));
-				continue;
-			}
-			write(fd, BIOSImage + Base, Length);
-			close(fd);
+			phx_write_raw(BIOSImage, Name, "Hole", NULL, Base,
+				      Length);
 			break;
 
 		case 0x02:
 			/* FFV modules */
-			Offset = Base;
-			while (Offset < Base + Length) {
-				Offset +=
-				    PhoenixExtractFFV(BIOSImage, BIOSLength,
-						      Offset);
-			}
+			PhoenixFFVWalk(BIOSImage, BIOSLength, Base, Length);
 			break;
 		}
 	}
@@ -667,7 +845,7 @@ void PhoenixVolume2(unsigned char *BIOSImage, int BIOSLength, int Offset)
 	} *Volume;
 
 	char Name[16], guid[37];
-	int fd, HoleNum = 0;
+	int HoleNum = 0;
 	uint32_t Base, Length, NumModules, ModNum;
 
 	Volume = (struct PhoenixVolumeDir2 *)(BIOSImage + Offset + 0x18);
@@ -692,40 +870,19 @@ void PhoenixVolume2(unsigned char *BIOSImage, int BIOSLength, int Offset)
 
 		if (!strcmp(guid, GUID_FFVMODULE)) {
 			/* FFV modules */
-			Offset = Base;
-			while (Offset < Base + Length) {
-				Offset +=
-				    PhoenixExtractFFV(BIOSImage, BIOSLength,
-						      Offset);
-			}
+			PhoenixFFVWalk(BIOSImage, BIOSLength, Base, Length);
 		} else if (!strcmp(guid, GUID_ESCD)) {
 			/* Extended System Configuration Data (and similar?) */
 			printf("\tESCD\n");
-			fd = open("ESCD.bin", O_RDWR | O_CREAT | O_TRUNC,
-				  S_IRUSR | S_IWUSR);
-			if (fd < 0) {
-				fprintf(stderr,
-					"Error: unable to open ESCD.bin: %s\n\n",
-					strerror(errno));
-				continue;
-			}
-			write(fd, BIOSImage + Base, Length);
-			close(fd);
+			phx_write_raw(BIOSImage, "ESCD.bin", "ESCD", guid,
+				      Base, Length);
 		} else if (!strcmp(guid, GUID_RAWCODE)) {
 			/* Raw BIOS code */
 			printf("\tHole (raw code)\n");
 			snprintf(Name, sizeof(Name), "hole_%02x.bin",
 				 HoleNum++);
-			fd = open(Name, O_RDWR | O_CREAT | O_TRUNC,
-				  S_IRUSR | S_IWUSR);
-			if (fd < 0) {
-				fprintf(stderr,
-					"Error: unable to open %s: %s\n\n",
-					Name, strerror(errno));
-				continue;
-			}
-			write(fd, BIOSImage + Base, Length);
-			close(fd);
+			phx_write_raw(BIOSImage, Name, "Hole", guid, Base,
+				      Length);
 		} else {
 			fprintf(stderr, "\tUnknown FFV module GUID: %s\n",
 				guid);
@@ -852,6 +1009,7 @@ PhoenixExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 	struct bcpCompress *bcpComp =
 	    (struct bcpCompress *)(BIOSImage + bcpoff);
 	phx.compression = bcpComp->alg;
+	phx.lzss_fill = bcpComp->commonCharacterLZSS;
 
 	/* Get some info */
 	char Date[9], Time[9], Version[9];
@@ -882,3 +1040,71 @@ PhoenixExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
 
 	return TRUE;
 }
+
+/*
+ * BCPVPD and $COMPIBM images are a single LZSS stream behind their
+ * header, the expanded size is not stored.
+ */
+static int PhoenixLZSSHeaderSize(unsigned char *BIOSImage, int BIOSLength)
+{
+	if ((BIOSLength > 0x52) && !memcmp(BIOSImage, "BCPVPD", 7))
+		return 0x52;
+	if ((BIOSLength > 8) && !memcmp(BIOSImage, "$COMPIBM", 8))
+		return 8;
+	return 0;
+}
+
+Bool PhoenixLZSSProbe(unsigned char *BIOSImage, int BIOSLength)
+{
+	return PhoenixLZSSHeaderSize(BIOSImage, BIOSLength) != 0;
+}
+
+Bool
+PhoenixLZSSExtract(unsigned char *BIOSImage, int BIOSLength, int BIOSOffset,
+		   uint32_t Offset1, uint32_t Offset2)
+{
+	struct ModuleInfo Info;
+	unsigned char *Buffer;
+	int HeaderSize, Size;
+
+	HeaderSize = PhoenixLZSSHeaderSize(BIOSImage, BIOSLength);
+	if (!HeaderSize)
+		return FALSE;
+
+	Size = CodecSize(CODEC_LZSS, BIOSImage + HeaderSize,
+			 BIOSLength - HeaderSize, CODEC_PARAMETER_DEFAULT);
+	if (Size <= 0)
+		return FALSE;
+
+	Info.Offset = HeaderSize;
+	Info.PackedSize = BIOSLength - HeaderSize;
+	Info.ExpandedSize = Size;
+	Info.Id = -1;
+	Info.Type = (HeaderSize == 8) ? "compibm" : "bcpvpd";
+	Info.Codec = CodecName(CODEC_LZSS);
+	Info.Name = NULL;
+	Info.Guid = NULL;
+	Info.File = (HeaderSize == 8) ? "compibm.rom" : "bcpvpd.rom";
+
+	printf("0x%05X (%6d bytes)   ->   %s\t(%d bytes)\n", HeaderSize,
+	       BIOSLength - HeaderSize, Info.File, Size);
+
+	if (!ModuleWanted(&Info))
+		return TRUE;
+
+	Buffer = MMapOutputFile(Info.File, Size);
+	if (!Buffer)
+		return FALSE;
+
+	if (CodecDecode(CODEC_LZSS, BIOSImage + HeaderSize,
+			BIOSLength - HeaderSize, Buffer, Size,
+			CODEC_PARAMETER_DEFAULT)) {
+		fprintf(stderr, "Error: Failed to decode %s with %s\n",
+			Info.File, Info.Codec);
+		CloseOutputFile(Buffer, Size);
+		return FALSE;
+	}
+	CloseOutputFile(Buffer, Size);
+
+	return TRUE;
+}
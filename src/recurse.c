@@ -0,0 +1,216 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Recursive extraction. Every output that a handler decodes is identified
+ * right away, while it is still in memory, and only the nested containers
+ * get copied onto a work queue. A pool of worker threads, which is running
+ * while the top level image is extracted, runs the matching handlers on
+ * them, with the outputs going to a "<output>.d" directory. Nothing gets
+ * read back from disk.
+ *
+ * The handlers keep their state per thread, so any number of containers
+ * get extracted at once.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <pthread.h>
+#include "compat.h"
+#include "bios_extract.h"
+
+struct RecurseItem {
+	unsigned char *Buffer;
+	int Length;
+	int Depth;
+	struct BIOSType *Type;
+	uint32_t Offset1, Offset2;
+	char *Directory;	/* where the nested outputs go */
+	struct RecurseItem *Next;
+};
+
+static struct RecurseItem *QueueHead, *QueueTail;
+static int QueueBusy;		/* threads which might still queue items */
+static pthread_mutex_t QueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t QueueCond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t *Workers;
+static int WorkerCount;
+
+/* The depth of the container being extracted by this thread. */
+static __thread int ContainerDepth;
+
+static void RecurseQueue(char *filename, unsigned char *Buffer, int size)
+{
+	struct RecurseItem *Item;
+	struct BIOSType *Type;
+	uint32_t Offset1, Offset2;
+
+	if (ContainerDepth >= Options.Depth)
+		return;
+
+	/* too small to hold anything we can identify */
+	if (size < 0x10)
+		return;
+
+	Type = BIOSIdentify(Buffer, size, &Offset1, &Offset2);
+	if (!Type)
+		return;
+
+	Item = malloc(sizeof(struct RecurseItem));
+	if (!Item) {
+		fprintf(stderr, "Error: Out of memory queueing %s\n", filename);
+		return;
+	}
+
+	Item->Buffer = malloc(size);
+	Item->Directory = malloc(strlen(filename) + 3);
+	if (!Item->Buffer || !Item->Directory) {
+		fprintf(stderr, "Error: Out of memory queueing %s\n", filename);
+		free(Item->Buffer);
+		free(Item->Directory);
+		free(Item);
+		return;
+	}
+
+	memcpy(Item->Buffer, Buffer, size);
+	Item->Length = size;
+	Item->Depth = ContainerDepth + 1;
+	Item->Type = Type;
+	Item->Offset1 = Offset1;
+	Item->Offset2 = Offset2;
+	sprintf(Item->Directory, "%s.d", filename);
+	Item->Next = NULL;
+
+	pthread_mutex_lock(&QueueLock);
+	if (QueueTail)
+		QueueTail->Next = Item;
+	else
+		QueueHead = Item;
+	QueueTail = Item;
+	pthread_cond_signal(&QueueCond);
+	pthread_mutex_unlock(&QueueLock);
+}
+
+static void RecurseItemExtract(struct RecurseItem *Item)
+{
+	printf("\nFound a nested %s image (%dkB), extracting to \"%s\"\n",
+	       Item->Type->Vendor, Item->Length >> 10, Item->Directory);
+
+	ContainerDepth = Item->Depth;
+	OutputContainerSet(Item->Buffer, Item->Length);
+	OutputDirectorySet(Item->Directory);
+
+	if (!BIOSExtract(Item->Type, Item->Buffer, Item->Length,
+			 Item->Offset1, Item->Offset2))
+		fprintf(stderr, "Error: Failed to extract \"%s\"\n",
+			Item->Directory);
+
+	OutputDirectorySet(NULL);
+	OutputContainerSet(NULL, 0);
+}
+
+static void *RecurseWorker(void *Unused)
+{
+	struct RecurseItem *Item;
+
+	pthread_mutex_lock(&QueueLock);
+	for (;;) {
+		while (!QueueHead && QueueBusy)
+			pthread_cond_wait(&QueueCond, &QueueLock);
+
+		Item = QueueHead;
+		if (!Item)
+			break;	/* nothing queued, and nobody left to queue */
+
+		QueueHead = Item->Next;
+		if (!QueueHead)
+			QueueTail = NULL;
+		QueueBusy++;
+		pthread_mutex_unlock(&QueueLock);
+
+		RecurseItemExtract(Item);
+
+		free(Item->Buffer);
+		free(Item->Directory);
+		free(Item);
+
+		pthread_mutex_lock(&QueueLock);
+		QueueBusy--;
+		if (!QueueBusy)
+			pthread_cond_broadcast(&QueueCond);
+	}
+	pthread_cond_broadcast(&QueueCond);
+	pthread_mutex_unlock(&QueueLock);
+
+	return NULL;
+}
+
+/*
+ * Start the workers, before the top level image gets extracted. The top
+ * level counts as busy until RecurseRun().
+ */
+void RecurseStart(void)
+{
+	int Jobs = ParallelJobs();
+
+	ContainerDepth = 0;
+	QueueBusy = 1;
+	OutputHookSet(RecurseQueue);
+
+	Workers = calloc(Jobs, sizeof(pthread_t));
+	if (!Workers) {
+		fprintf(stderr, "Error: Out of memory for %d threads\n", Jobs);
+		return;
+	}
+
+	for (WorkerCount = 0; WorkerCount < Jobs; WorkerCount++)
+		if (pthread_create(&Workers[WorkerCount], NULL, RecurseWorker,
+				   NULL)) {
+			fprintf(stderr, "Error: Failed to start a worker\n");
+			break;
+		}
+}
+
+/*
+ * Once the top level image is done, wait for the workers to get through
+ * all nested containers.
+ */
+Bool RecurseRun(void)
+{
+	pthread_mutex_lock(&QueueLock);
+	QueueBusy--;
+	pthread_cond_broadcast(&QueueCond);
+	pthread_mutex_unlock(&QueueLock);
+
+	/* work along when no thread could be started at all */
+	if (!WorkerCount)
+		RecurseWorker(NULL);
+
+	while (WorkerCount--)
+		pthread_join(Workers[WorkerCount], NULL);
+
+	free(Workers);
+	Workers = NULL;
+	WorkerCount = 0;
+	OutputHookSet(NULL);
+
+	return TRUE;
+}
@@ -0,0 +1,178 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Byte scanning helpers. These run over whole images and decompressed
+ * modules, so they use SSE2 where available and fall back to comparing
+ * a machine word at a time.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "compat.h"
+#include "scan.h"
+
+/*
+ * Returns the number of bytes at the start of Buffer that equal Value.
+ */
+int
+ScanRunLength(const unsigned char *Buffer, int Length, unsigned char Value)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	__m128i Pattern = _mm_set1_epi8((char)Value);
+
+	for (; (i + 16) <= Length; i += 16) {
+		__m128i Data = _mm_loadu_si128((const __m128i *)(Buffer + i));
+		unsigned int Mask =
+		    _mm_movemask_epi8(_mm_cmpeq_epi8(Data, Pattern));
+
+		if (Mask != 0xFFFF)
+			return i + __builtin_ctz(~Mask);
+	}
+#else
+	uint64_t Pattern = 0x0101010101010101ULL * Value;
+
+	for (; (i + 8) <= Length; i += 8) {
+		uint64_t Data;
+
+		memcpy(&Data, Buffer + i, 8);
+		if (Data != Pattern)
+			break;
+	}
+#endif
+
+	while ((i < Length) && (Buffer[i] == Value))
+		i++;
+
+	return i;
+}
+
+/*
+ * Returns the offset of the first 32bit little endian Value at a 4 byte
+ * aligned offset from the start of Buffer, or -1.
+ */
+int ScanFind32(const unsigned char *Buffer, int Length, uint32_t Value)
+{
+	int i = 0;
+	uint32_t Data;
+
+#ifdef __SSE2__
+	__m128i Pattern = _mm_set1_epi32(Value);
+
+	for (; (i + 16) <= Length; i += 16) {
+		__m128i Block = _mm_loadu_si128((const __m128i *)(Buffer + i));
+		unsigned int Mask =
+		    _mm_movemask_epi8(_mm_cmpeq_epi32(Block, Pattern));
+
+		if (Mask)
+			return i + __builtin_ctz(Mask);
+	}
+#endif
+
+	for (; (i + 4) <= Length; i += 4) {
+		memcpy(&Data, Buffer + i, 4);
+		if (le32toh(Data) == Value)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * The sum of the 32bit little endian words in Buffer, Length is a multiple
+ * of 4.
+ */
+uint32_t ScanSum32(const unsigned char *Buffer, int Length)
+{
+	uint32_t Sum = 0, Data;
+	int i = 0;
+
+#ifdef __SSE2__
+	__m128i Sums = _mm_setzero_si128();
+	uint32_t Lanes[4];
+
+	for (; (i + 16) <= Length; i += 16)
+		Sums = _mm_add_epi32(Sums, _mm_loadu_si128((const __m128i *)
+							   (Buffer + i)));
+
+	_mm_storeu_si128((__m128i *) Lanes, Sums);
+	Sum = Lanes[0] + Lanes[1] + Lanes[2] + Lanes[3];
+#endif
+
+	for (; (i + 4) <= Length; i += 4) {
+		memcpy(&Data, Buffer + i, 4);
+		Sum += le32toh(Data);
+	}
+
+	return Sum;
+}
+
+/*
+ * Returns the first offset in Buffer at which one of the Count byte pairs
+ * in Pairs starts, or -1. This is the one pass over the data for finding
+ * any of a set of signatures, the candidates still have to be compared in
+ * full.
+ */
+int
+ScanFindPairs(const unsigned char *Buffer, int Length,
+	      const unsigned char *Pairs, int Count)
+{
+	int i = 0, j;
+
+#ifdef __SSE2__
+	__m128i First[SCAN_PAIRS_MAX], Second[SCAN_PAIRS_MAX];
+
+	if (Count <= SCAN_PAIRS_MAX) {
+		for (j = 0; j < Count; j++) {
+			First[j] = _mm_set1_epi8(Pairs[2 * j]);
+			Second[j] = _mm_set1_epi8(Pairs[2 * j + 1]);
+		}
+
+		for (; (i + 17) <= Length; i += 16) {
+			__m128i Data0 =
+			    _mm_loadu_si128((const __m128i *)(Buffer + i));
+			__m128i Data1 =
+			    _mm_loadu_si128((const __m128i *)(Buffer + i + 1));
+			__m128i Match = _mm_setzero_si128();
+			unsigned int Mask;
+
+			for (j = 0; j < Count; j++)
+				Match = _mm_or_si128(Match, _mm_and_si128(
+					_mm_cmpeq_epi8(Data0, First[j]),
+					_mm_cmpeq_epi8(Data1, Second[j])));
+
+			Mask = _mm_movemask_epi8(Match);
+			if (Mask)
+				return i + __builtin_ctz(Mask);
+		}
+	}
+#endif
+
+	for (; (i + 2) <= Length; i++)
+		for (j = 0; j < Count; j++)
+			if ((Buffer[i] == Pairs[2 * j]) &&
+			    (Buffer[i + 1] == Pairs[2 * j + 1]))
+				return i;
+
+	return -1;
+}
@@ -0,0 +1,30 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+int ScanRunLength(const unsigned char *Buffer, int Length,
+		  unsigned char Value);
+
+int ScanFind32(const unsigned char *Buffer, int Length, uint32_t Value);
+uint32_t ScanSum32(const unsigned char *Buffer, int Length);
+
+#define SCAN_PAIRS_MAX 16
+int ScanFindPairs(const unsigned char *Buffer, int Length,
+		  const unsigned char *Pairs, int Count);
+
+#endif				/* SCAN_H */
@@ -0,0 +1,772 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * UEFI firmware volumes, as in PI volume 3. Every volume in the image is
+ * walked, down through its FFS files and their sections, and the leaf
+ * sections are written out straight from the mmapped image.
+ *
+ * Compressed sections are not decoded while walking. They are collected
+ * and decoded in parallel once a walk is done, then the decoded sections
+ * are walked in the order they were found, which may turn up the next
+ * round of compressed sections. This keeps the output names and the
+ * manifest independent of the number of threads.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "compat.h"
+#include "bios_extract.h"
+#include "codec.h"
+#include "efi_extract.h"
+#include "scan.h"
+
+struct UEFIVolumeHeader {
+	uint8_t ZeroVector[16];
+	uint8_t FileSystemGuid[16];
+	uint64_t Length;
+	char Signature[4];	/* "_FVH" */
+	uint32_t Attributes;
+	uint16_t HeaderLength;
+	uint16_t Checksum;
+	uint16_t ExtHeaderOffset;
+	uint8_t Reserved;
+	uint8_t Revision;
+	/* followed by the block map, at least one entry and a terminator */
+};
+
+#define UEFI_VOLUME_HEADER_MIN	0x48
+#define UEFI_VOLUME_ERASE_POLARITY	0x00000800
+
+struct UEFIVolumeExtHeader {
+	uint8_t Name[16];
+	uint32_t Size;
+};
+
+struct UEFIFileHeader {
+	uint8_t Name[16];
+	uint8_t HeaderChecksum;
+	uint8_t FileChecksum;
+	uint8_t Type;
+	uint8_t Attributes;
+	uint8_t Size[3];
+	uint8_t State;
+	/* FFS3 large files are followed by a 64bit size */
+};
+
+#define UEFI_FILE_TAIL_PRESENT	0x01	/* FFS2 */
+#define UEFI_FILE_LARGE		0x01	/* FFS3 */
+#define UEFI_FILE_DELETED	0x10	/* state, with the erase polarity */
+
+#define UEFI_FILE_TYPE_RAW	0x01
+#define UEFI_FILE_TYPE_FREEFORM	0x02
+#define UEFI_FILE_TYPE_PAD	0xF0
+
+struct UEFISectionHeader {
+	uint8_t Size[3];	/* 0xFFFFFF: a 32bit size follows */
+	uint8_t Type;
+};
+
+struct UEFICompressionSection {
+	uint32_t UncompressedLength;
+	uint8_t CompressionType;	/* 0: none, 1: EFI 1.1 or Tiano */
+};
+
+struct UEFIGuidSection {
+	uint8_t Guid[16];
+	uint16_t DataOffset;	/* from the start of the section */
+	uint16_t Attributes;
+};
+
+#define UEFI_GUID_PROCESSING_REQUIRED	0x01
+
+#define UEFI_SECTION_COMPRESSION	0x01
+#define UEFI_SECTION_GUID_DEFINED	0x02
+#define UEFI_SECTION_USER_INTERFACE	0x15
+#define UEFI_SECTION_FIRMWARE_VOLUME	0x17
+
+/* file systems: FFS1 (as used by early Apple images), FFS2 and FFS3 */
+static unsigned char UEFIFFS1Guid[16] = {
+	0xD9, 0x54, 0x93, 0x7A, 0x68, 0x04, 0x4A, 0x44,
+	0x81, 0xCE, 0x0B, 0xF6, 0x17, 0xD8, 0x90, 0xDF
+};
+
+static unsigned char UEFIFFS2Guid[16] = {
+	0x78, 0xE5, 0x8C, 0x8C, 0x3D, 0x8A, 0x1C, 0x4F,
+	0x99, 0x35, 0x89, 0x61, 0x85, 0xC3, 0x2D, 0xD3
+};
+
+static unsigned char UEFIFFS3Guid[16] = {
+	0x7A, 0xC0, 0x73, 0x54, 0xCB, 0x3D, 0xCA, 0x4D,
+	0xBD, 0x6F, 0x1E, 0x96, 0x89, 0xE7, 0x34, 0x9A
+};
+
+/* GUID defined sections */
+static unsigned char UEFICRC32Guid[16] = {
+	0xB0, 0xCD, 0x1B, 0xFC, 0x31, 0x7D, 0xAA, 0x49,
+	0x93, 0x6A, 0xA4, 0x60, 0x0D, 0x9D, 0xD0, 0x83
+};
+
+static unsigned char UEFILZMAGuid[16] = {
+	0x98, 0x58, 0x4E, 0xEE, 0x14, 0x39, 0x59, 0x42,
+	0x9D, 0x6E, 0xDC, 0x7B, 0xD7, 0x94, 0x03, 0xCF
+};
+
+static unsigned char UEFITianoGuid[16] = {
+	0xAD, 0x80, 0x12, 0xA3, 0x1E, 0x48, 0xB6, 0x41,
+	0x95, 0xE8, 0x12, 0x7F, 0x4C, 0x98, 0x47, 0x79
+};
+
+static struct UEFIFileType {
+	uint8_t Id;
+	char *Name;
+} UEFIFileTypes[] = {
+	{0x00, "all"},
+	{0x01, "raw"},
+	{0x02, "freeform"},
+	{0x03, "seccore"},
+	{0x04, "peicore"},
+	{0x05, "dxecore"},
+	{0x06, "peim"},
+	{0x07, "driver"},
+	{0x08, "combined_peim_driver"},
+	{0x09, "application"},
+	{0x0A, "smm"},
+	{0x0B, "volume"},
+	{0x0C, "combined_smm_dxe"},
+	{0x0D, "smmcore"},
+	{0x0E, "mm_standalone"},
+	{0x0F, "mmcore_standalone"},
+	{0xF0, "pad"},
+	{0x00, NULL}
+};
+
+static struct UEFISectionType {
+	uint8_t Id;
+	char *Extension;
+} UEFISectionTypes[] = {
+	{0x10, "efi"},		/* PE32 */
+	{0x11, "pic.efi"},
+	{0x12, "te"},
+	{0x13, "depex"},
+	{0x14, "ver"},
+	{0x16, "bios"},		/* COMPATIBILITY16 */
+	{0x18, "guid"},		/* FREEFORM_SUBTYPE_GUID */
+	{0x19, "raw"},
+	{0x1B, "pei.depex"},
+	{0x1C, "smm.depex"},
+	{0x00, NULL}
+};
+
+/* One per FFS file, kept until all of its sections are walked. */
+struct UEFIFile {
+	char Guid[37];
+	char *Name;		/* from the user interface section */
+	int Type;
+	int Volume;
+	int Sections;		/* written so far, to number the next */
+	struct UEFIFile *Next;
+};
+
+/* A compressed section, to be decoded and walked in a later round. */
+struct UEFIJob {
+	unsigned char *Packed;
+	int PackedSize;
+	int ExpandedSize;
+	int Codec;
+	int Parameter;
+	unsigned char *Buffer;	/* decoded */
+	struct UEFIFile *File;
+	/* the stream in the image that this ends up coming from */
+	uint32_t Offset;
+	uint32_t Size;
+};
+
+/* per thread, as nested images get extracted in parallel */
+static __thread unsigned char *UEFIImage;
+static __thread int UEFIVolumes;
+static __thread struct UEFIFile *UEFIFiles;
+static __thread struct UEFIJob *UEFIJobs;
+static __thread int UEFIJobCount, UEFIJobSize;
+
+static char *UEFIFileTypeName(int Type)
+{
+	int i;
+
+	for (i = 0; UEFIFileTypes[i].Name; i++)
+		if (UEFIFileTypes[i].Id == Type)
+			return UEFIFileTypes[i].Name;
+	return "unknown";
+}
+
+static char *UEFISectionExtension(int Type, unsigned char *Data, int Length)
+{
+	int i;
+
+	if (Type == 0x19) {
+		if ((Length >= 8) && !memcmp(Data, "\x89PNG\r\n\x1A\n", 8))
+			return "png";
+		if ((Length >= 4) && !memcmp(Data, "icns", 4))
+			return "icns";
+	}
+
+	for (i = 0; UEFISectionTypes[i].Extension; i++)
+		if (UEFISectionTypes[i].Id == Type)
+			return UEFISectionTypes[i].Extension;
+	return "data";
+}
+
+static uint32_t UEFISize24(uint8_t * Size)
+{
+	return Size[0] | (Size[1] << 8) | (Size[2] << 16);
+}
+
+/*
+ * Returns the length of the volume at Buffer, or 0 when there is none. The
+ * header checksum has to hold, so that stray "_FVH" strings do not count.
+ */
+static uint32_t UEFIVolumeCheck(unsigned char *Buffer, int Length)
+{
+	struct UEFIVolumeHeader *Header = (struct UEFIVolumeHeader *)Buffer;
+	uint16_t Sum = 0;
+	uint32_t HeaderLength;
+	int i;
+
+	if (Length < UEFI_VOLUME_HEADER_MIN)
+		return 0;
+	if (memcmp(Header->Signature, "_FVH", 4))
+		return 0;
+
+	HeaderLength = le16toh(Header->HeaderLength);
+	if ((HeaderLength < UEFI_VOLUME_HEADER_MIN) || (HeaderLength & 1) ||
+	    (HeaderLength > Length))
+		return 0;
+
+	for (i = 0; i < HeaderLength; i += 2)
+		Sum += Buffer[i] | (Buffer[i + 1] << 8);
+	if (Sum)
+		return 0;
+
+	if ((le64toh(Header->Length) < HeaderLength) ||
+	    (le64toh(Header->Length) > 0x7FFFFFFF))
+		return 0;
+
+	return le64toh(Header->Length);
+}
+
+static struct UEFIFile *UEFIFileAdd(unsigned char *Name, int Type,
+				    int Volume)
+{
+	struct UEFIFile *File;
+
+	File = calloc(1, sizeof(struct UEFIFile));
+	if (!File) {
+		fprintf(stderr, "Error: Out of memory for a file\n");
+		return NULL;
+	}
+
+	GuidString(File->Guid, Name);
+	File->Type = Type;
+	File->Volume = Volume;
+	File->Next = UEFIFiles;
+	UEFIFiles = File;
+
+	return File;
+}
+
+/*
+ * Where Data came from in the image: itself, or the stream it was decoded
+ * from. Origin is the index of the job which decoded it, or -1.
+ */
+static void
+UEFIModuleInfo(struct ModuleInfo *Info, unsigned char *Data, int Length,
+	       int Origin)
+{
+	if (Origin < 0) {
+		Info->Offset = Data - UEFIImage;
+		Info->PackedSize = Length;
+		Info->Codec = CodecName(CODEC_STORED);
+	} else {
+		Info->Offset = UEFIJobs[Origin].Offset;
+		Info->PackedSize = UEFIJobs[Origin].Size;
+		Info->Codec = CodecName(UEFIJobs[Origin].Codec);
+	}
+	Info->ExpandedSize = Length;
+}
+
+/*
+ * UI names come from the image, and must not lead out of the output
+ * directory: no path separators, no "..", only printable ASCII.
+ */
+static void UEFINameClean(char *Clean, int Size, char *Name)
+{
+	int i;
+
+	for (i = 0; Name[i] && (i < (Size - 1)); i++) {
+		if ((Name[i] < 0x20) || (Name[i] > 0x7E) || (Name[i] == '/') ||
+		    (Name[i] == '\\') || ((Name[i] == '.') &&
+					 ((i && (Name[i - 1] == '.')) ||
+					  (Name[i + 1] == '.'))))
+			Clean[i] = '_';
+		else
+			Clean[i] = Name[i];
+	}
+	Clean[i] = '\0';
+}
+
+static void
+UEFILeafWrite(struct UEFIFile *File, char *Extension, unsigned char *Data,
+	      int Length, int Origin)
+{
+	struct ModuleInfo Info;
+	char filename[128], Name[96];
+
+	UEFINameClean(Name, sizeof(Name), File->Name ? File->Name : File->Guid);
+	snprintf(filename, sizeof(filename), "fv%02d_%s_%02d.%s",
+		 File->Volume, Name, File->Sections++, Extension);
+
+	printf("\t\t%-10s (%7d bytes)    ->    %s\n", Extension, Length,
+	       filename);
+
+	UEFIModuleInfo(&Info, Data, Length, Origin);
+	Info.Id = File->Type;
+	Info.Type = UEFIFileTypeName(File->Type);
+	Info.Name = File->Name;
+	Info.Guid = File->Guid;
+	Info.File = filename;
+
+	if (ModuleWanted(&Info))
+		WriteOutputFile(filename, Data, Length);
+}
+
+static void
+UEFIJobAdd(struct UEFIFile *File, unsigned char *Packed, int PackedSize,
+	   int Codec, int Parameter, int Origin)
+{
+	struct UEFIJob *Job;
+	struct ModuleInfo Info;
+	int ExpandedSize;
+
+	ExpandedSize = CodecSize(Codec, Packed, PackedSize, Parameter);
+	if ((ExpandedSize <= 0) || (ExpandedSize > 0x4000000)) {
+		fprintf(stderr, "Error: Invalid %s section in %s\n",
+			CodecName(Codec), File->Guid);
+		return;
+	}
+
+	/* without decoding, the compressed section is all there is to list */
+	if (Options.List) {
+		UEFIModuleInfo(&Info, Packed, PackedSize, Origin);
+		if (Origin < 0)
+			Info.Codec = CodecName(Codec);
+		Info.ExpandedSize = ExpandedSize;
+		Info.Id = File->Type;
+		Info.Type = UEFIFileTypeName(File->Type);
+		Info.Name = File->Name;
+		Info.Guid = File->Guid;
+		Info.File = NULL;
+		ModuleWanted(&Info);
+		return;
+	}
+
+	if (UEFIJobCount == UEFIJobSize) {
+		Job = realloc(UEFIJobs,
+			      (UEFIJobSize + 64) * sizeof(struct UEFIJob));
+		if (!Job) {
+			fprintf(stderr, "Error: Out of memory for %d sections\n",
+				UEFIJobSize + 64);
+			return;
+		}
+		UEFIJobs = Job;
+		UEFIJobSize += 64;
+	}
+
+	Job = &UEFIJobs[UEFIJobCount++];
+	Job->Packed = Packed;
+	Job->PackedSize = PackedSize;
+	Job->ExpandedSize = ExpandedSize;
+	Job->Codec = Codec;
+	Job->Parameter = Parameter;
+	Job->Buffer = NULL;
+	Job->File = File;
+	if (Origin < 0) {
+		Job->Offset = Packed - UEFIImage;
+		Job->Size = PackedSize;
+	} else {
+		Job->Offset = UEFIJobs[Origin].Offset;
+		Job->Size = UEFIJobs[Origin].Size;
+	}
+}
+
+static void UEFIJobDecode(void *Private, int Index)
+{
+	struct UEFIJob *Job = ((struct UEFIJob *)Private) + Index;
+
+	Job->Buffer = malloc(Job->ExpandedSize);
+	if (!Job->Buffer)
+		return;
+
+	if (CodecDecode(Job->Codec, Job->Packed, Job->PackedSize, Job->Buffer,
+			Job->ExpandedSize, Job->Parameter)) {
+		free(Job->Buffer);
+		Job->Buffer = NULL;
+	}
+}
+
+static void UEFIVolumeWalk(unsigned char *Buffer, int Length, int Origin);
+
+/*
+ * The user interface section names the file, it is usually found next to
+ * the sections which get written out.
+ */
+static void UEFINameFind(struct UEFIFile *File, unsigned char *Buffer,
+			 int Length)
+{
+	struct UEFISectionHeader *Header;
+	uint32_t Offset = 0, Size;
+	int i;
+
+	while ((Offset + 4) <= Length) {
+		Header = (struct UEFISectionHeader *)(Buffer + Offset);
+		Size = UEFISize24(Header->Size);
+		if ((Size < 4) || (Size > (Length - Offset)))
+			return;
+
+		if (Header->Type == UEFI_SECTION_USER_INTERFACE) {
+			File->Name = malloc((Size - 4) / 2 + 1);
+			if (!File->Name)
+				return;
+
+			/* UCS-2, only ASCII is kept */
+			for (i = 0; i < ((Size - 4) / 2); i++) {
+				if (!Buffer[Offset + 4 + 2 * i])
+					break;
+				if ((Buffer[Offset + 4 + 2 * i + 1]) ||
+				    (Buffer[Offset + 4 + 2 * i] < 0x20) ||
+				    (Buffer[Offset + 4 + 2 * i] > 0x7E))
+					File->Name[i] = '_';
+				else
+					File->Name[i] = Buffer[Offset + 4 + 2 * i];
+			}
+			File->Name[i] = '\0';
+			return;
+		}
+
+		Offset = (Offset + Size + 3) & ~3;
+	}
+}
+
+/*
+ * Walk a list of sections, these are 4 byte aligned.
+ */
+static void
+UEFISectionsWalk(struct UEFIFile *File, unsigned char *Buffer, int Length,
+		 int Origin)
+{
+	struct UEFISectionHeader *Header;
+	struct UEFICompressionSection *Compression;
+	struct UEFIGuidSection *Guided;
+	uint32_t Offset = 0, Next, Size, HeaderSize, DataOffset;
+	unsigned char *Data;
+	char guid[37];
+
+	if (!File->Name)
+		UEFINameFind(File, Buffer, Length);
+
+	while ((Offset + 4) <= Length) {
+		Header = (struct UEFISectionHeader *)(Buffer + Offset);
+		Size = UEFISize24(Header->Size);
+		HeaderSize = 4;
+		if ((Size == 0xFFFFFF) && ((Offset + 8) <= Length)) {
+			Size = le32toh(*(uint32_t *) (Buffer + Offset + 4));
+			HeaderSize = 8;
+		}
+
+		if ((Size < HeaderSize) || (Size > (Length - Offset))) {
+			fprintf(stderr, "Error: Invalid section at 0x%X in %s\n",
+				Offset, File->Guid);
+			return;
+		}
+
+		Next = (Offset + Size + 3) & ~3;
+		Data = Buffer + Offset + HeaderSize;
+		Size -= HeaderSize;
+
+		switch (Header->Type) {
+		case UEFI_SECTION_COMPRESSION:
+			if (Size < sizeof(struct UEFICompressionSection))
+				break;
+			Compression = (struct UEFICompressionSection *)Data;
+			Data += sizeof(struct UEFICompressionSection);
+			Size -= sizeof(struct UEFICompressionSection);
+
+			if (!Compression->CompressionType)
+				UEFISectionsWalk(File, Data, Size, Origin);
+			else
+				UEFIJobAdd(File, Data, Size, CODEC_EFI,
+					   CODEC_PARAMETER_DEFAULT, Origin);
+			break;
+
+		case UEFI_SECTION_GUID_DEFINED:
+			if (Size < sizeof(struct UEFIGuidSection))
+				break;
+			Guided = (struct UEFIGuidSection *)Data;
+			DataOffset = le16toh(Guided->DataOffset);
+			if ((DataOffset < (HeaderSize + 20)) ||
+			    (DataOffset > (Size + HeaderSize)))
+				break;
+			Data = Buffer + Offset + DataOffset;
+			Size -= DataOffset - HeaderSize;
+
+			if (!memcmp(Guided->Guid, UEFILZMAGuid, 16))
+				UEFIJobAdd(File, Data, Size, CODEC_LZMA,
+					   CODEC_PARAMETER_DEFAULT, Origin);
+			else if (!memcmp(Guided->Guid, UEFITianoGuid, 16))
+				UEFIJobAdd(File, Data, Size, CODEC_EFI,
+					   EFI_COMPRESSION_TIANO, Origin);
+			else if (!memcmp(Guided->Guid, UEFICRC32Guid, 16) ||
+				 !(le16toh(Guided->Attributes) &
+				   UEFI_GUID_PROCESSING_REQUIRED))
+				UEFISectionsWalk(File, Data, Size, Origin);
+			else {
+				GuidString(guid, Guided->Guid);
+				printf("\t\tUnsupported GUID defined section %s"
+				       "\n", guid);
+				UEFILeafWrite(File, "guided", Data, Size,
+					      Origin);
+			}
+			break;
+
+		case UEFI_SECTION_USER_INTERFACE:
+			break;
+
+		case UEFI_SECTION_FIRMWARE_VOLUME:
+			UEFIVolumeWalk(Data, Size, Origin);
+			break;
+
+		default:
+			UEFILeafWrite(File, UEFISectionExtension(Header->Type,
+								 Data, Size),
+				      Data, Size, Origin);
+			break;
+		}
+
+		Offset = Next;
+	}
+}
+
+/*
+ * Walk the FFS files of the volume at Buffer, which are 8 byte aligned.
+ */
+static void UEFIVolumeWalk(unsigned char *Buffer, int Length, int Origin)
+{
+	struct UEFIVolumeHeader *Header = (struct UEFIVolumeHeader *)Buffer;
+	struct UEFIFileHeader *FileHeader;
+	struct UEFIFile *File;
+	uint32_t VolumeLength, Offset, Size, HeaderSize, DataSize;
+	unsigned char Erased, Sum;
+	Bool FFS3;
+	int i, Volume;
+
+	VolumeLength = UEFIVolumeCheck(Buffer, Length);
+	if (!VolumeLength) {
+		fprintf(stderr, "Error: Invalid firmware volume header\n");
+		return;
+	}
+	if (VolumeLength > Length) {
+		fprintf(stderr, "Warning: Firmware volume is truncated to 0x%X"
+			" bytes\n", Length);
+		VolumeLength = Length;
+	}
+
+	Volume = UEFIVolumes++;
+	printf("Firmware volume %d (0x%X bytes)", Volume, VolumeLength);
+	if (Origin < 0)
+		printf(" at 0x%08X", (unsigned int)(Buffer - UEFIImage));
+	printf("\n");
+
+	if (!memcmp(Header->FileSystemGuid, UEFIFFS3Guid, 16))
+		FFS3 = TRUE;
+	else if (!memcmp(Header->FileSystemGuid, UEFIFFS2Guid, 16) ||
+		 !memcmp(Header->FileSystemGuid, UEFIFFS1Guid, 16))
+		FFS3 = FALSE;
+	else {
+		printf("\tNot a file system, skipped.\n");
+		return;
+	}
+
+	Erased = (le32toh(Header->Attributes) & UEFI_VOLUME_ERASE_POLARITY) ?
+	    0xFF : 0x00;
+
+	Offset = le16toh(Header->HeaderLength);
+	if (le16toh(Header->ExtHeaderOffset) &&
+	    ((le16toh(Header->ExtHeaderOffset) + 20) <= VolumeLength))
+		Offset = le16toh(Header->ExtHeaderOffset) +
+		    le32toh(((struct UEFIVolumeExtHeader *)
+			     (Buffer + le16toh(Header->ExtHeaderOffset)))->Size);
+	Offset = (Offset + 7) & ~7;
+
+	while ((Offset + sizeof(struct UEFIFileHeader)) <= VolumeLength) {
+		/* the rest is free space */
+		if (ScanRunLength(Buffer + Offset,
+				  sizeof(struct UEFIFileHeader), Erased) ==
+		    sizeof(struct UEFIFileHeader))
+			break;
+
+		FileHeader = (struct UEFIFileHeader *)(Buffer + Offset);
+		Size = UEFISize24(FileHeader->Size);
+		HeaderSize = sizeof(struct UEFIFileHeader);
+		if (FFS3 && (FileHeader->Attributes & UEFI_FILE_LARGE)) {
+			HeaderSize += 8;
+			if ((Offset + HeaderSize) > VolumeLength)
+				break;
+			Size = le32toh(*(uint32_t *) (Buffer + Offset +
+						     sizeof(struct
+							    UEFIFileHeader)));
+		}
+
+		if ((Size < HeaderSize) || (Size > (VolumeLength - Offset))) {
+			fprintf(stderr, "Error: Invalid file size at 0x%X in "
+				"volume %d\n", Offset, Volume);
+			break;
+		}
+
+		DataSize = Size - HeaderSize;
+		if (!FFS3 && (FileHeader->Attributes & UEFI_FILE_TAIL_PRESENT)
+		    && (DataSize >= 2))
+			DataSize -= 2;
+
+		File = UEFIFileAdd(FileHeader->Name, FileHeader->Type,
+				   Volume);
+		if (!File)
+			break;
+
+		printf("\t%s %-20s (%7d bytes)\n", File->Guid,
+		       UEFIFileTypeName(File->Type), DataSize);
+
+		/* the header sums up to 0, without the state and file sum */
+		for (Sum = 0, i = 0; i < HeaderSize; i++)
+			Sum += Buffer[Offset + i];
+		Sum -= FileHeader->State + FileHeader->FileChecksum;
+		if (Sum)
+			fprintf(stderr, "Warning: Invalid header checksum on "
+				"file %s\n", File->Guid);
+
+		if ((FileHeader->State ^ Erased) & UEFI_FILE_DELETED)
+			printf("\t\tDeleted, skipped.\n");
+		else if (File->Type == UEFI_FILE_TYPE_RAW)
+			UEFILeafWrite(File, "raw", Buffer + Offset + HeaderSize,
+				      DataSize, Origin);
+		else if (File->Type != UEFI_FILE_TYPE_PAD)
+			UEFISectionsWalk(File, Buffer + Offset + HeaderSize,
+					 DataSize, Origin);
+
+		Offset = (Offset + Size + 7) & ~7;
+	}
+}
+
+/*
+ * Returns the offset of the next valid volume at or after Offset, or -1.
+ */
+static int UEFIVolumeFind(unsigned char *Image, int Length, int Offset)
+{
+	unsigned char *p;
+
+	while ((Offset + UEFI_VOLUME_HEADER_MIN) <= Length) {
+		p = memmem(Image + Offset + 0x28, Length - Offset - 0x28,
+			   "_FVH", 4);
+		if (!p)
+			break;
+		Offset = p - Image - 0x28;
+
+		if (UEFIVolumeCheck(Image + Offset, Length - Offset))
+			return Offset;
+		Offset++;
+	}
+
+	return -1;
+}
+
+Bool UEFIProbe(unsigned char *Image, int Length)
+{
+	return UEFIVolumeFind(Image, Length, 0) != -1;
+}
+
+Bool
+UEFIExtract(unsigned char *Image, int Length, int ImageOffset,
+	    uint32_t Offset1, uint32_t Offset2)
+{
+	struct UEFIFile *File;
+	uint32_t VolumeLength;
+	int Offset, Done = 0, Count, i;
+
+	UEFIImage = Image;
+	UEFIVolumes = 0;
+
+	Offset = 0;
+	while ((Offset = UEFIVolumeFind(Image, Length, Offset)) != -1) {
+		UEFIVolumeWalk(Image + Offset, Length - Offset, -1);
+
+		/* a truncated volume runs to the end of the image */
+		VolumeLength = UEFIVolumeCheck(Image + Offset, Length - Offset);
+		if (VolumeLength >= (Length - Offset))
+			break;
+		Offset += VolumeLength;
+	}
+
+	while (Done < UEFIJobCount) {
+		Count = UEFIJobCount - Done;
+		ParallelRun(Count, UEFIJobDecode, UEFIJobs + Done);
+
+		for (i = Done; i < (Done + Count); i++) {
+			if (!UEFIJobs[i].Buffer) {
+				fprintf(stderr, "Error: Failed to decode the "
+					"%s section of %s\n",
+					CodecName(UEFIJobs[i].Codec),
+					UEFIJobs[i].File->Guid);
+				continue;
+			}
+
+			printf("%s section of %s (%d bytes)\n",
+			       CodecName(UEFIJobs[i].Codec),
+			       UEFIJobs[i].File->Guid, UEFIJobs[i].ExpandedSize);
+			UEFISectionsWalk(UEFIJobs[i].File, UEFIJobs[i].Buffer,
+					 UEFIJobs[i].ExpandedSize, i);
+		}
+
+		Done += Count;
+	}
+
+	for (i = 0; i < UEFIJobCount; i++)
+		free(UEFIJobs[i].Buffer);
+	free(UEFIJobs);
+	UEFIJobs = NULL;
+	UEFIJobCount = UEFIJobSize = 0;
+
+	while (UEFIFiles) {
+		File = UEFIFiles;
+		UEFIFiles = File->Next;
+		free(File->Name);
+		free(File);
+	}
+
+	return UEFIVolumes > 0;
+}
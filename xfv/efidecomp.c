@@ -3,6 +3,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "efihack.h"
 
@@ -27,15 +31,210 @@ EfiDecompress (
                IN      UINT32                  ScratchSize
                );
 
-int main(int argc, char **argv)
+EFI_STATUS
+EFIAPI
+TianoDecompress (
+                 IN      VOID                    *Source,
+                 IN      UINT32                  SrcSize,
+                 IN OUT  VOID                    *Destination,
+                 IN      UINT32                  DstSize,
+                 IN OUT  VOID                    *Scratch,
+                 IN      UINT32                  ScratchSize
+                 );
+
+EFI_STATUS
+EFIAPI
+EfiTianoGetVersion (
+                    IN      VOID                    *Source,
+                    IN      UINT32                  SrcSize,
+                    IN OUT  VOID                    *Scratch,
+                    IN      UINT32                  ScratchSize,
+                    OUT     UINT8                   *Version
+                    );
+
+// 0 to detect the version from the data, 1 for EFI 1.1, 2 for Tiano
+static int force_version = 0;
+
+// per thread state, reused for every input
+struct worker {
+    char *scratchbuf;
+    UINT32 scratchlen;
+    char *dstbuf;
+    UINT32 dstlen;
+};
+
+// the list of inputs for batch mode
+static char **inputs;
+static int input_count, input_next;
+static int failures;
+static pthread_mutex_t input_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int decompress(struct worker *w, char *buffer, UINT32 fill, UINT32 *DstSize)
+{
+    UINT32 ScratchSize;
+    UINT8 Version;
+    EFI_STATUS Status;
+    char *p;
+
+    // inspect data
+    Status = EfiGetInfo(buffer, fill, DstSize, &ScratchSize);
+    if (Status != EFI_SUCCESS) {
+        fprintf(stderr, "EFI ERROR (get info)\n");
+        return 1;
+    }
+
+    if (w->scratchlen < ScratchSize) {
+        p = realloc(w->scratchbuf, ScratchSize);
+        if (p == NULL) {
+            fprintf(stderr, "Out of memory!\n");
+            return 1;
+        }
+        w->scratchbuf = p;
+        w->scratchlen = ScratchSize;
+    }
+    if (w->dstlen < *DstSize) {
+        p = realloc(w->dstbuf, *DstSize);
+        if (p == NULL) {
+            fprintf(stderr, "Out of memory!\n");
+            return 1;
+        }
+        w->dstbuf = p;
+        w->dstlen = *DstSize;
+    }
+
+    Version = force_version;
+    if (Version == 0) {
+        Status = EfiTianoGetVersion(buffer, fill, w->scratchbuf, ScratchSize, &Version);
+        if (Status != EFI_SUCCESS) {
+            fprintf(stderr, "EFI ERROR (neither EFI 1.1 nor Tiano)\n");
+            return 1;
+        }
+    }
+
+    // decompress data
+    if (Version == 1)
+        Status = EfiDecompress(buffer, fill, w->dstbuf, *DstSize, w->scratchbuf, ScratchSize);
+    else
+        Status = TianoDecompress(buffer, fill, w->dstbuf, *DstSize, w->scratchbuf, ScratchSize);
+    if (Status != EFI_SUCCESS) {
+        fprintf(stderr, "EFI ERROR (decompress)\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int write_all(int fd, char *dstbuf, UINT32 DstSize)
+{
+    ssize_t got;
+
+    while (DstSize > 0) {
+        got = write(fd, dstbuf, DstSize);
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error during write: %d\n", errno);
+            return 1;
+        } else {
+            dstbuf += got;
+            DstSize -= got;
+        }
+    }
+
+    return 0;
+}
+
+// decompress a file, to stdout or to <file>.dec
+static int decompress_file(struct worker *w, char *filename, int to_stdout)
+{
+    struct stat st;
+    char *buffer, *outname;
+    UINT32 DstSize;
+    int fd, ret;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    if (st.st_size == 0) {
+        fprintf(stderr, "%s: empty file\n", filename);
+        close(fd);
+        return 1;
+    }
+
+    buffer = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buffer == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+
+    ret = decompress(w, buffer, st.st_size, &DstSize);
+    munmap(buffer, st.st_size);
+    if (ret) {
+        fprintf(stderr, "%s: failed\n", filename);
+        return 1;
+    }
+
+    if (to_stdout)
+        return write_all(1, w->dstbuf, DstSize);
+
+    outname = malloc(strlen(filename) + 5);
+    if (outname == NULL) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+    sprintf(outname, "%s.dec", filename);
+
+    fd = open(outname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", outname, strerror(errno));
+        free(outname);
+        return 1;
+    }
+    ret = write_all(fd, w->dstbuf, DstSize);
+    close(fd);
+    free(outname);
+
+    return ret;
+}
+
+static void *batch_worker(void *unused)
 {
+    struct worker w;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+
+    for (;;) {
+        pthread_mutex_lock(&input_lock);
+        i = input_next++;
+        pthread_mutex_unlock(&input_lock);
+        if (i >= input_count)
+            break;
+
+        if (decompress_file(&w, inputs[i], 0)) {
+            pthread_mutex_lock(&input_lock);
+            failures++;
+            pthread_mutex_unlock(&input_lock);
+        }
+    }
+
+    free(w.scratchbuf);
+    free(w.dstbuf);
+    return NULL;
+}
+
+static int decompress_stdin(void)
+{
+    struct worker w;
     char *buffer;
     long buflen, fill;
     ssize_t got;
-    char *dstbuf, *scratchbuf;
     UINT32 DstSize;
-    UINT32 ScratchSize;
-    EFI_STATUS Status;
 
     // read all data from stdin
     buflen = 32768;
@@ -71,37 +270,79 @@ int main(int argc, char **argv)
 
     //fprintf(stderr, "got %d bytes\n", fill);
 
-    // inspect data
-    Status = EfiGetInfo(buffer, fill, &DstSize, &ScratchSize);
-    if (Status != EFI_SUCCESS) {
-        fprintf(stderr, "EFI ERROR (get info)\n");
+    memset(&w, 0, sizeof(w));
+    if (decompress(&w, buffer, fill, &DstSize))
         return 1;
+
+    // write to stdout
+    return write_all(1, w.dstbuf, DstSize);
+}
+
+static void usage(char *name)
+{
+    fprintf(stderr, "usage: %s [-e|-t] [-j <threads>] [<file>...]\n", name);
+    fprintf(stderr, "  Without files, stdin is decompressed to stdout. A single file is\n");
+    fprintf(stderr, "  decompressed to stdout, several files to <file>.dec each.\n");
+    fprintf(stderr, "  -e, -t      EFI 1.1 or Tiano, instead of detecting it\n");
+    fprintf(stderr, "  -j <n>      number of threads for several files\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct worker w;
+    pthread_t *threads;
+    int c, i, jobs = 0;
+
+    while ((c = getopt(argc, argv, "etj:h")) != -1) {
+        switch (c) {
+        case 'e':
+            force_version = 1;
+            break;
+        case 't':
+            force_version = 2;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
     }
-    dstbuf = malloc(DstSize);
-    scratchbuf = malloc(ScratchSize);
-    if (dstbuf == NULL || scratchbuf == NULL) {
-        fprintf(stderr, "Out of memory!\n");
-        return 1;
+
+    if (optind == argc)
+        return decompress_stdin();
+
+    if (optind == argc - 1) {
+        memset(&w, 0, sizeof(w));
+        return decompress_file(&w, argv[optind], 1);
     }
 
-    // decompress data
-    Status = EfiDecompress(buffer, fill, dstbuf, DstSize, scratchbuf, ScratchSize);
-    if (Status != EFI_SUCCESS) {
-        fprintf(stderr, "EFI ERROR (decompress)\n");
+    // batch mode
+    inputs = argv + optind;
+    input_count = argc - optind;
+
+    if (jobs < 1)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > input_count)
+        jobs = input_count;
+
+    threads = calloc(jobs, sizeof(pthread_t));
+    if (threads == NULL) {
+        fprintf(stderr, "Out of memory!\n");
         return 1;
     }
 
-    // write to stdout
-    while (DstSize > 0) {
-        got = write(1, dstbuf, DstSize);
-        if (got < 0) {
-            fprintf(stderr, "Error during write: %d\n", errno);
-            return 1;
-        } else {
-            dstbuf += got;
-            DstSize -= got;
-        }
-    }
+    for (i = 0; i < jobs; i++)
+        if (pthread_create(&threads[i], NULL, batch_worker, NULL))
+            break;
+    if (i == 0)
+        batch_worker(NULL);
+    while (i--)
+        pthread_join(threads[i], NULL);
 
-    return 0;
+    free(threads);
+    return failures ? 1 : 0;
 }
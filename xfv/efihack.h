@@ -9,6 +9,9 @@
 #define INT16  int16_t
 #define INT32  int32_t
 #define INT64  int64_t
+#define BOOLEAN uint8_t
+#define TRUE  1
+#define FALSE 0
 
 #define EFI_STATUS   UINT32
 #define EFI_SUCCESS (0)
@@ -2,6 +2,8 @@
 
 import sys
 import os
+import ctypes
+import subprocess
 from struct import unpack
 
 fvh_count = 0
@@ -143,26 +145,77 @@ def handle_fv(fvdata, name='default'):
 
 if sys.platform == 'win32':
   efidecomp_path = os.path.join(os.path.dirname(__file__), "UEFI_Decompressor")
-  efidecomp_cmd = '"%s" %s %s'
+  efidecomp_lib_path = None
 else:
   efidecomp_path = os.path.dirname(os.path.realpath(__file__)) + "/efidecomp"
-  efidecomp_cmd = "%s < %s > %s"
+  efidecomp_lib_path = os.path.dirname(os.path.realpath(__file__)) + "/libefidecomp.so"
+
+# The decoders from Decompress.c, called in-process. Without the library,
+# every section goes through the efidecomp tool instead.
+efidecomp_lib = None
+if efidecomp_lib_path is not None:
+    try:
+        efidecomp_lib = ctypes.CDLL(efidecomp_lib_path)
+    except OSError:
+        print "WARNING: %s not found, falling back to %s" % (efidecomp_lib_path, efidecomp_path)
+
+# The LZMA decoder from src/lzma_extract.c, otherwise lzmadec is run.
+biosdecomp_lib = None
+if efidecomp_lib_path is not None:
+    try:
+        biosdecomp_lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.realpath(__file__)), os.pardir, "libbiosdecomp.so"))
+    except OSError:
+        print "WARNING: libbiosdecomp.so not found, falling back to lzmadec"
 
 ### Handle decompression of a compressed section
 
-def decompress2(compdata):
-    f = file("_tmp_decompress", "wb")
-    f.write(compdata)
-    f.close()
-    
-    cmd = efidecomp_cmd % ( efidecomp_path, '_tmp_decompress', '_tmp_result')
-    print "cmd: %r" % cmd
-    os.system(cmd)
-    
-    f = file("_tmp_result", "rb")
-    decompdata = f.read()
-    f.close()
-    return decompdata
+def run_filter(cmd, data):
+    p = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    result = p.communicate(data)[0]
+    if p.returncode != 0:
+        print "WARNING: %s failed" % cmd[0]
+    return result
+
+def efi_decompress(compdata):
+    if efidecomp_lib is None:
+        return run_filter([efidecomp_path], compdata)
+
+    dstsize = ctypes.c_uint32()
+    scratchsize = ctypes.c_uint32()
+    if efidecomp_lib.EfiGetInfo(compdata, len(compdata), ctypes.byref(dstsize), ctypes.byref(scratchsize)) != 0:
+        print "ERROR: Invalid EFI compressed data"
+        return ""
+
+    dst = ctypes.create_string_buffer(dstsize.value)
+    scratch = ctypes.create_string_buffer(scratchsize.value)
+    version = ctypes.c_uint8()
+    if efidecomp_lib.EfiTianoGetVersion(compdata, len(compdata), scratch, scratchsize.value, ctypes.byref(version)) != 0:
+        print "ERROR: Neither EFI 1.1 nor Tiano compressed data"
+        return ""
+
+    if version.value == 1:
+        func = efidecomp_lib.EfiDecompress
+    else:
+        func = efidecomp_lib.TianoDecompress
+    if func(compdata, len(compdata), dst, dstsize.value, scratch, scratchsize.value) != 0:
+        print "ERROR: EFI decompression failed"
+        return ""
+    return dst.raw
+
+def lzma_decompress(compdata):
+    if biosdecomp_lib is None:
+        return run_filter(["lzmadec"], compdata)
+
+    dstsize = biosdecomp_lib.LZMAExpandedSize(compdata, len(compdata), None, 0)
+    if dstsize < 0:
+        print "ERROR: Invalid LZMA header"
+        return ""
+
+    dst = ctypes.create_string_buffer(dstsize)
+    if biosdecomp_lib.LZMADecode(compdata, len(compdata), dst, dstsize) < 0:
+        print "ERROR: LZMA decompression failed"
+        return ""
+    return dst.raw
 
 def decompress(compdata):
     (sectlenandtype, uncomplen, comptype) = unpack("< L L B", compdata[0:9])
@@ -173,32 +226,15 @@ def decompress(compdata):
         return compdata[9:]
     elif comptype == 1:
         print "WARNING: this code path might not work";
-        f = file("_tmp_decompress", "wb")
-        f.write(compdata[9:])
-        f.close()
-        
-        cmd = efidecomp_cmd % ( efidecomp_path, '_tmp_decompress', '_tmp_result')
-        #cmd = "./efidecomp <_tmp_decompress >_tmp_result"
-        os.system(cmd)
-        
-        f = file("_tmp_result", "rb")
-        decompdata = f.read()
-        f.close()
+        decompdata = efi_decompress(compdata[9:])
 
         if len(decompdata) < uncomplen:
             print "WARNING: Decompressed data too short!"
         return decompdata
 
     elif comptype == 2:
-        f = file("_tmp_decompress", "wb")
-        f.write(compdata[13:sectlen+4]) # for some reason there is junk in 9:13 that I don't see in the raw files?! yuk.
-        f.close()
-        
-        os.system("lzmadec <_tmp_decompress >_tmp_result")
-        
-        f = file("_tmp_result", "rb")
-        decompdata = f.read()
-        f.close()
+        # for some reason there is junk in 9:13 that I don't see in the raw files?! yuk.
+        decompdata = lzma_decompress(compdata[13:sectlen+4])
         
         if len(decompdata) < uncomplen:
             print "WARNING: Decompressed data too short!"
@@ -274,7 +310,7 @@ def handle_sections(filename, sectindex, imagedata):
                                             dataoffset:dataoffset + datalen])
         elif secttype == 1: # compressed
             sectdata = imagedata[dataoffset:dataoffset+datalen]
-            decdata = decompress2(sectdata)
+            decdata = efi_decompress(sectdata)
             print "  %02d  COMPRESSED %d => %d" % (sectindex, datalen, len(decdata))
             if filename_override == None:
                 filename_override = get_filename(decdata)